@@ -1,9 +1,9 @@
 #include "stdafx.h"
 #include "latinize.h"
 
-// Context menu integration for the component.
-// This file registers a popup menu group and several commands that call into
-// the latinize feature (see latinize.cpp).
+// Menu integration for the component.
+// This file registers popup menu groups (context menu and Library main menu)
+// and commands that call into the latinize feature (see latinize.cpp).
 
 // Menu group GUID: groups our commands under "Latinize Sort" in the context menu.
 // Use a stable GUID so foobar2000 can remember menu customizations.
@@ -101,3 +101,66 @@ public:
 
 // Factory registers the item with foobar2000.
 static contextmenu_item_factory_t<latinize_context_item> g_latinize_context_factory;
+
+// Main menu: Library > Latinize Sort. Commands here work without a selection.
+static const GUID guid_latinize_mainmenu_group = { 0x8d3f61a4, 0x27b0, 0x4c5e, { 0x9a, 0x13, 0x6e, 0xf2, 0x48, 0xb1, 0x0d, 0x7c } };
+static mainmenu_group_popup_factory g_latinize_mainmenu_group(
+	guid_latinize_mainmenu_group, mainmenu_groups::library, mainmenu_commands::sort_priority_dontcare, "Latinize Sort"
+);
+
+class latinize_mainmenu_commands : public mainmenu_commands {
+public:
+	enum { cmd_resume = 0, cmd_total };
+
+	t_uint32 get_command_count() override { return cmd_total; }
+
+	GUID get_command(t_uint32 index) override {
+		switch (index) {
+		case cmd_resume:
+			return GUID{ 0x51c7e2d9, 0x8a46, 0x4f0b, { 0xb5, 0x2e, 0x93, 0x0d, 0x6a, 0x17, 0xc4, 0xe8 } };
+		default:
+			uBugCheck();
+		}
+	}
+
+	void get_name(t_uint32 index, pfc::string_base& out) override {
+		switch (index) {
+		case cmd_resume:
+			out = "Resume latinize job";
+			return;
+		default:
+			uBugCheck();
+		}
+	}
+
+	bool get_description(t_uint32 index, pfc::string_base& out) override {
+		switch (index) {
+		case cmd_resume:
+			out = "Continues the last latinize run that was aborted, failed partway or was interrupted by closing foobar2000. Items already answered come from the cache.";
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	GUID get_parent() override { return guid_latinize_mainmenu_group; }
+
+	void execute(t_uint32 index, service_ptr_t<service_base>) override {
+		switch (index) {
+		case cmd_resume:
+			foo_latinize::ResumeLatinizeJob(core_api::get_main_window());
+			return;
+		default:
+			uBugCheck();
+		}
+	}
+
+	// Grayed out while there is nothing to resume.
+	bool get_display(t_uint32 index, pfc::string_base& text, t_uint32& flags) override {
+		const bool rv = mainmenu_commands::get_display(index, text, flags);
+		if (rv && index == cmd_resume && !foo_latinize::HasPendingLatinizeJob()) flags |= flag_disabled;
+		return rv;
+	}
+};
+
+static mainmenu_commands_factory_t<latinize_mainmenu_commands> g_latinize_mainmenu_factory;
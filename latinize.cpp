@@ -1,12 +1,33 @@
 #include "stdafx.h"
 #include "latinize.h"
+#include "transliterate.h"
+#include "transport.h"
 
 #include <SDK/cfg_var.h>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <random>
+#include <string>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace foo_latinize {
 	// Configuration keys live in foobar2000 config storage. GUIDs must be
@@ -17,36 +38,123 @@ namespace foo_latinize {
 	static constexpr GUID guid_cfg_api_model = { 0x1f566c64, 0xf2a9, 0x4c0a, { 0x86, 0x13, 0x2a, 0x78, 0x5f, 0x88, 0x5d, 0x42 } };
 	static constexpr GUID guid_cfg_prompt = { 0x2d7b06e1, 0xf728, 0x4f49, { 0x90, 0x0a, 0x6d, 0xb7, 0x62, 0x5a, 0xf0, 0x18 } };
 	static constexpr GUID guid_cfg_db_path = { 0x9d5c8d7e, 0x7e2a, 0x4c39, { 0x9a, 0x27, 0xa7, 0x3f, 0x5a, 0x31, 0x06, 0x92 } };
+	static constexpr GUID guid_cfg_concurrency = { 0x4b1e9f3a, 0x62d8, 0x4c17, { 0xa5, 0x3e, 0x0d, 0x7c, 0x91, 0x28, 0xe4, 0x6b } };
+	static constexpr GUID guid_cfg_batch_prompt = { 0xd0a7c5e2, 0x3f49, 0x4b6e, { 0x8c, 0x15, 0x27, 0xe9, 0x4a, 0x60, 0xb3, 0xd8 } };
+	static constexpr GUID guid_cfg_batch_size = { 0x58e2b6f1, 0xa04c, 0x4d93, { 0x9e, 0x7a, 0x13, 0xc6, 0x2f, 0x85, 0x0b, 0x4e } };
+	static constexpr GUID guid_cfg_rate_rpm = { 0x7a93d1c4, 0x2be5, 0x4f60, { 0x84, 0x1d, 0xc9, 0x36, 0x5e, 0x0f, 0xa2, 0x77 } };
+	static constexpr GUID guid_cfg_rate_tpm = { 0xe61f08b5, 0xd47a, 0x4c3b, { 0xb6, 0x92, 0x5a, 0x0e, 0x83, 0x1c, 0x6d, 0xf9 } };
+	static constexpr GUID guid_cfg_fast_keys = { 0x2c87e4d9, 0x51a3, 0x4f0b, { 0x9d, 0x64, 0xb8, 0x17, 0x3e, 0xa2, 0x05, 0xc1 } };
+	static constexpr GUID guid_cfg_index_storage = { 0xb3f6a920, 0x7d1e, 0x4c58, { 0xa4, 0x0b, 0x6e, 0x95, 0x2d, 0xc3, 0x18, 0x7a } };
+	static constexpr GUID guid_cfg_stream = { 0x91d4e6a3, 0x0c7b, 0x4e25, { 0xb1, 0x8f, 0x46, 0xa0, 0xd3, 0x7c, 0x29, 0x5e } };
+	static constexpr GUID guid_cfg_local_engine = { 0x4a0f7c2e, 0xe915, 0x4d6b, { 0x83, 0x2a, 0x5f, 0xc1, 0x90, 0x6e, 0xb4, 0x17 } };
+	static constexpr GUID guid_cfg_auto_latinize = { 0xe27b5d40, 0x3a9c, 0x4f81, { 0xa6, 0x1e, 0x0b, 0x74, 0xc8, 0x29, 0xd5, 0x93 } };
+	static constexpr GUID guid_cfg_auto_threads = { 0x5fc8a213, 0x6d0e, 0x47b2, { 0x9e, 0x45, 0xd1, 0x3a, 0x87, 0x0c, 0x6b, 0xf2 } };
+	static constexpr GUID guid_cfg_auto_pause_playback = { 0x0b94e6f7, 0xc251, 0x4a3d, { 0x8f, 0x70, 0x2e, 0xa5, 0x19, 0xb3, 0x4c, 0x68 } };
+	static constexpr GUID guid_cfg_negative_ttl = { 0x73a1c5e8, 0x4b0d, 0x4e29, { 0xb7, 0x36, 0x58, 0xe0, 0x2f, 0x9c, 0x14, 0xad } };
+	static constexpr GUID guid_cfg_keep_alive = { 0x2c6e90b1, 0x5fa7, 0x4d18, { 0x8e, 0x03, 0xa4, 0x7b, 0x1d, 0xc2, 0x96, 0x5f } };
+	static constexpr GUID guid_cfg_http2 = { 0xd8147a3f, 0x0b6c, 0x4e95, { 0xa2, 0x5d, 0x71, 0xe9, 0x3c, 0x08, 0xbf, 0x24 } };
+	static constexpr GUID guid_cfg_stats_totals = { 0x6a2e51c9, 0xf3d8, 0x4b07, { 0x95, 0x1c, 0x3e, 0x80, 0xa7, 0x4d, 0x62, 0xeb } };
 	// Defaults used when the user clicks "Reset" in Preferences.
 	static constexpr char default_api_url_value[] = "https://api.deepseek.com/chat/completions";
 	static constexpr char default_api_model_value[] = "deepseek-chat";
+	// Rules shared by the single-item and batch prompts.
+#define LATINIZE_PROMPT_RULES \
+		"Rules:\n" \
+		"- Ignore all symbols and punctuation.\n" \
+		"- For Chinese, output pinyin without tone marks.\n" \
+		"- For Japanese, output romaji.\n" \
+		"- If any Japanese characters appear (Hiragana, Katakana, or Kanji used with Japanese), treat the whole title/album as Japanese for romanization.\n" \
+		"- For Chinese (Simplified/Traditional), treat the whole title/album as Chinese for pinyin.\n" \
+		"- Treat each title/album as a single language by default; do not mix languages inside one title.\n" \
+		"- Example: \"\xE5\xBF\x83\xE3\x81\xAE\xE5\xA3\xB0\" should be \"kokoro no koe\" (Japanese), NOT \"xin no sheng(Chinese)\".\n" \
+		"- For English/Latin script, keep the letters as-is.\n" \
+		"- Output only letters A-Z and digits 0-9 (case-insensitive) and single spaces between words.\n"
 	static constexpr char default_prompt_value[] =
 		"Task: Convert song title and album name to Latin letters and digits (A-Z, 0-9 only).\n"
-		"Rules:\n"
-		"- Ignore all symbols and punctuation.\n"
-		"- For Chinese, output pinyin without tone marks.\n"
-		"- For Japanese, output romaji.\n"
-		"- If any Japanese characters appear (Hiragana, Katakana, or Kanji used with Japanese), treat the whole title/album as Japanese for romanization.\n"
-		"- For Chinese (Simplified/Traditional), treat the whole title/album as Chinese for pinyin.\n"
-		"- Treat each title/album as a single language by default; do not mix languages inside one title.\n"
-		"- Example: \"\xE5\xBF\x83\xE3\x81\xAE\xE5\xA3\xB0\" should be \"kokoro no koe\" (Japanese), NOT \"xin no sheng(Chinese)\".\n"
-		"- For English/Latin script, keep the letters as-is.\n"
-		"- Output only letters A-Z and digits 0-9 (case-insensitive) and single spaces between words.\n"
+		LATINIZE_PROMPT_RULES
 		"Output exactly two lines:\n"
 		"title_latin: <latinized title>\n"
 		"album_latin: <latinized album>\n"
 		"Title: {title}\n"
 		"Album: {album}\n";
+	// Batch prompt: {items} expands to "N.title: ..." / "N.album: ..." lines.
+	static constexpr char default_batch_prompt_value[] =
+		"Task: Convert each numbered song title and album name below to Latin letters and digits (A-Z, 0-9 only).\n"
+		LATINIZE_PROMPT_RULES
+		"For every item N output exactly two lines, keeping the item number:\n"
+		"N.title_latin: <latinized title>\n"
+		"N.album_latin: <latinized album>\n"
+		"Answer every item, in order. Items:\n"
+		"{items}";
+#undef LATINIZE_PROMPT_RULES
+	// Number of requests RunLatinize keeps in flight at once.
+	static constexpr t_uint32 default_concurrency_value = 8;
+	// Title/album pairs sent per request; 1 disables batching.
+	static constexpr t_uint32 default_batch_size_value = 25;
+	// Provider budgets for the shared rate limiter; 0 means no limit.
+	static constexpr t_uint32 default_rate_rpm_value = 0;
+	static constexpr t_uint32 default_rate_tpm_value = 0;
+	// Key hash for newly created caches: 0 = MD5 (compatible), 1 = XXH64.
+	static constexpr t_uint32 default_fast_keys_value = 0;
+	// Cache storage: 0 = FBLT file, 1 = foobar2000 metadb index (read at startup).
+	static constexpr t_uint32 default_index_storage_value = 0;
+	// Batch requests ask for a streamed (SSE) answer and cache records as they arrive.
+	static constexpr t_uint32 default_stream_value = 0;
+	// Kana, Latin and hanzi from the pinyin table are latinized without the API.
+	static constexpr t_uint32 default_local_engine_value = 1;
+	// Background latinization of library additions: off by default since it
+	// spends API budget without being asked to.
+	static constexpr t_uint32 default_auto_latinize_value = 0;
+	static constexpr t_uint32 default_auto_threads_value = 2;
+	static constexpr t_uint32 default_auto_pause_playback_value = 1;
+	// Days a track that could not be latinized is skipped; 0 retries every run.
+	static constexpr t_uint32 default_negative_ttl_value = 7;
+	// Persistent connections where available; HTTP/2 is opt-in, since some
+	// self-hosted endpoints mishandle it.
+	static constexpr t_uint32 default_keep_alive_value = 1;
+	static constexpr t_uint32 default_http2_value = 0;
 	// Config variables (persisted by foobar2000).
 	cfg_string cfg_api_url(guid_cfg_api_url, default_api_url_value);
 	cfg_string cfg_api_key(guid_cfg_api_key, "");
 	cfg_string cfg_api_model(guid_cfg_api_model, default_api_model_value);
 	cfg_string cfg_prompt(guid_cfg_prompt, default_prompt_value);
 	cfg_string cfg_db_path(guid_cfg_db_path, "");
+	cfg_string cfg_batch_prompt(guid_cfg_batch_prompt, default_batch_prompt_value);
+	cfg_uint cfg_concurrency(guid_cfg_concurrency, default_concurrency_value);
+	cfg_uint cfg_batch_size(guid_cfg_batch_size, default_batch_size_value);
+	cfg_uint cfg_rate_rpm(guid_cfg_rate_rpm, default_rate_rpm_value);
+	cfg_uint cfg_rate_tpm(guid_cfg_rate_tpm, default_rate_tpm_value);
+	cfg_uint cfg_fast_keys(guid_cfg_fast_keys, default_fast_keys_value);
+	cfg_uint cfg_index_storage(guid_cfg_index_storage, default_index_storage_value);
+	cfg_uint cfg_stream(guid_cfg_stream, default_stream_value);
+	cfg_uint cfg_local_engine(guid_cfg_local_engine, default_local_engine_value);
+	cfg_uint cfg_auto_latinize(guid_cfg_auto_latinize, default_auto_latinize_value);
+	cfg_uint cfg_auto_threads(guid_cfg_auto_threads, default_auto_threads_value);
+	cfg_uint cfg_auto_pause_playback(guid_cfg_auto_pause_playback, default_auto_pause_playback_value);
+	cfg_uint cfg_negative_ttl(guid_cfg_negative_ttl, default_negative_ttl_value);
+	cfg_uint cfg_keep_alive(guid_cfg_keep_alive, default_keep_alive_value);
+	cfg_uint cfg_http2(guid_cfg_http2, default_http2_value);
+	// Latinize Stats totals across sessions (not a setting; see format_stats()).
+	static cfg_string cfg_stats_totals(guid_cfg_stats_totals, "");
 
 	const char* default_api_url() { return default_api_url_value; }
 	const char* default_api_model() { return default_api_model_value; }
 	const char* default_prompt() { return default_prompt_value; }
+	const char* default_batch_prompt() { return default_batch_prompt_value; }
+	t_uint32 default_concurrency() { return default_concurrency_value; }
+	t_uint32 default_batch_size() { return default_batch_size_value; }
+	t_uint32 default_rate_rpm() { return default_rate_rpm_value; }
+	t_uint32 default_rate_tpm() { return default_rate_tpm_value; }
+	t_uint32 default_fast_keys() { return default_fast_keys_value; }
+	t_uint32 default_index_storage() { return default_index_storage_value; }
+	t_uint32 default_stream() { return default_stream_value; }
+	t_uint32 default_local_engine() { return default_local_engine_value; }
+	t_uint32 default_auto_latinize() { return default_auto_latinize_value; }
+	t_uint32 default_auto_threads() { return default_auto_threads_value; }
+	t_uint32 default_auto_pause_playback() { return default_auto_pause_playback_value; }
+	t_uint32 default_negative_ttl() { return default_negative_ttl_value; }
+	t_uint32 default_keep_alive() { return default_keep_alive_value; }
+	t_uint32 default_http2() { return default_http2_value; }
 
 	// Default DB location inside the foobar2000 profile directory.
 	static pfc::string8 get_db_path_fallback() {
@@ -70,8 +178,8 @@ namespace foo_latinize {
 }
 
 namespace {
-	static void trim_ascii(pfc::string8& s);
 	static pfc::string8 sanitize_latin(const char* in);
+	static pfc::string8 sanitize_latin(const char* in, size_t length);
 
 	// In-memory record for cached latinized values.
 	struct latin_record {
@@ -79,8 +187,69 @@ namespace {
 		pfc::string8 album;
 	};
 
+	// How cache keys are derived from the key string. Stored in the DB header,
+	// since existing keys cannot be converted: a DB keeps its scheme until it
+	// is cleared, and only empty DBs pick up the configured one.
+	enum key_scheme : t_uint32 {
+		key_md5 = 0,	// MD5 folded to 64 bits; v1/v2 files and the default
+		key_xxh64 = 1,
+	};
+
+	// Scheme of the loaded DB (set by latin_db), read by every key derivation.
+	static std::atomic<t_uint32> g_keyScheme{ key_md5 };
+
+	// XXH64 (xxHash, seed 0): fast non-cryptographic 64-bit hash, used as an
+	// alternative cache key when the DB was created with key_xxh64.
+	static t_uint64 xxh64(const void* data, size_t length) {
+		static constexpr t_uint64 p1 = 0x9E3779B185EBCA87ull;
+		static constexpr t_uint64 p2 = 0xC2B2AE3D27D4EB4Full;
+		static constexpr t_uint64 p3 = 0x165667B19E3779F9ull;
+		static constexpr t_uint64 p4 = 0x85EBCA77C2B2AE63ull;
+		static constexpr t_uint64 p5 = 0x27D4EB2F165667C5ull;
+		auto rotl = [](t_uint64 x, int r) { return (x << r) | (x >> (64 - r)); };
+		auto read64 = [](const t_uint8* p) { t_uint64 v; memcpy(&v, p, 8); return v; };
+		auto read32 = [](const t_uint8* p) { t_uint32 v; memcpy(&v, p, 4); return v; };
+		auto round = [&](t_uint64 acc, t_uint64 input) { return rotl(acc + input * p2, 31) * p1; };
+		auto merge = [&](t_uint64 acc, t_uint64 val) { return (acc ^ round(0, val)) * p1 + p4; };
+
+		const t_uint8* p = (const t_uint8*)data;
+		const t_uint8* const end = p + length;
+		t_uint64 h;
+		if (length >= 32) {
+			t_uint64 v1 = p1 + p2, v2 = p2, v3 = 0, v4 = 0 - p1;
+			for (const t_uint8* limit = end - 32; p <= limit; p += 32) {
+				v1 = round(v1, read64(p));
+				v2 = round(v2, read64(p + 8));
+				v3 = round(v3, read64(p + 16));
+				v4 = round(v4, read64(p + 24));
+			}
+			h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+			h = merge(h, v1);
+			h = merge(h, v2);
+			h = merge(h, v3);
+			h = merge(h, v4);
+		} else {
+			h = p5;
+		}
+		h += (t_uint64)length;
+		for (; p + 8 <= end; p += 8) h = rotl(h ^ round(0, read64(p)), 27) * p1 + p4;
+		if (p + 4 <= end) {
+			h = rotl(h ^ (read32(p) * p1), 23) * p2 + p3;
+			p += 4;
+		}
+		for (; p < end; ++p) h = rotl(h ^ (*p * p5), 11) * p1;
+		h ^= h >> 33;
+		h *= p2;
+		h ^= h >> 29;
+		h *= p3;
+		h ^= h >> 32;
+		return h;
+	}
+
 	// Helper to build deterministic hashes from metadata. This lets us cache
 	// results per track and per album consistently.
+	// Runs for every visible row on repaint, so the scripts and hasher are
+	// resolved once and key strings are formatted into per-thread buffers.
 	class latin_keyer {
 	public:
 	latin_keyer() {
@@ -88,238 +257,1559 @@ namespace {
 		compiler->compile_safe_ex(m_track, "%artist% - %title% - %album%");
 		// Use album title only to keep album latinization consistent across tracks.
 		compiler->compile_safe_ex(m_album, "%album%");
+		m_md5 = hasher_md5::get();
 	}
 
-		metadb_index_hash hash_track(const file_info& info, const playable_location& location) {
-			pfc::string_formatter s;
-			m_track->run_simple(location, &info, s);
-			return static_api_ptr_t<hasher_md5>()->process_single_string(s).xorHalve();
+		metadb_index_hash hash_track(const file_info& info, const playable_location& location, t_uint32 scheme = g_keyScheme.load(std::memory_order_relaxed)) {
+			return hash(m_track, info, location, scheme);
+		}
+
+		metadb_index_hash hash_album(const file_info& info, const playable_location& location, t_uint32 scheme = g_keyScheme.load(std::memory_order_relaxed)) {
+			return hash(m_album, info, location, scheme);
 		}
 
-		metadb_index_hash hash_album(const file_info& info, const playable_location& location) {
-			pfc::string_formatter s;
-			m_album->run_simple(location, &info, s);
-			return static_api_ptr_t<hasher_md5>()->process_single_string(s).xorHalve();
+		// Key of a bare string, hashed with the scheme of the other keys.
+		metadb_index_hash hash_text(const char* text, size_t length, t_uint32 scheme = g_keyScheme.load(std::memory_order_relaxed)) {
+			if (scheme == key_xxh64) return xxh64(text, length);
+			return m_md5->process_single(text, length).xorHalve();
 		}
 	private:
+		metadb_index_hash hash(const titleformat_object::ptr& script, const file_info& info, const playable_location& location, t_uint32 scheme) {
+			// Keeps its capacity between calls, so steady-state hashing does not allocate.
+			static thread_local pfc::string_formatter s;
+			s.reset();
+			script->run_simple(location, &info, s);
+			return hash_text(s.get_ptr(), s.length(), scheme);
+		}
+
 		titleformat_object::ptr m_track;
 		titleformat_object::ptr m_album;
+		hasher_md5::ptr m_md5;
+	};
+
+	static latin_keyer& get_keyer() {
+		static latin_keyer g_keyer;
+		return g_keyer;
+	}
+
+	// String-cache key of a source title or album name: the text with
+	// surrounding whitespace trimmed and inner runs collapsed to one space,
+	// so copies that differ only in spacing share one entry. Keys live in
+	// their own table (see latin_db), apart from album and track keys.
+	static metadb_index_hash hash_source_text(const char* text) {
+		static thread_local pfc::string_formatter s;
+		s.reset();
+		bool space = false;
+		for (const char* p = text; *p; ++p) {
+			const char c = *p;
+			if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+				space = s.length() > 0;
+				continue;
+			}
+			if (space) s.add_char(' ');
+			space = false;
+			s.add_char(c);
+		}
+		return get_keyer().hash_text(s.get_ptr(), s.length());
+	}
+
+	// Optional storage in the core metadb index, following the pattern in
+	// rating.cpp. Records are pinned to the same keys latin_keyer derives
+	// (MD5 scheme), so display fields and batch runs are unchanged. The core
+	// takes over caching, crash-safe persistence, retention of entries whose
+	// tracks left the library, and hash-based refresh.
+	static constexpr GUID guid_index_track = { 0x5e27c1d4, 0x8a36, 0x4b90, { 0x91, 0xf2, 0x0c, 0x7d, 0x4a, 0xe8, 0x63, 0x25 } };
+	static constexpr GUID guid_index_album = { 0xc84b09e7, 0x2f15, 0x46d3, { 0xb8, 0x5a, 0x93, 0x1e, 0x60, 0xd7, 0x4c, 0xbf } };
+	// Keep entries for four weeks after their last matching track disappears.
+	static const t_filetimestamp index_retention = system_time_periods::week * 4;
+
+	class latin_index_client : public metadb_index_client {
+	public:
+		latin_index_client(bool album) : m_album(album) {}
+
+		metadb_index_hash transform(const file_info& info, const playable_location& location) override {
+			return m_album ? get_keyer().hash_album(info, location, key_md5) : get_keyer().hash_track(info, location, key_md5);
+		}
+	private:
+		const bool m_album;
+	};
+
+	class latin_index_store {
+	public:
+		bool active() const { return m_api != nullptr; }
+
+		// Registers both indexes; called once during startup when enabled.
+		void start() {
+			// Never destroyed or released, as in rating.cpp: the core may call
+			// into the clients until the process exits.
+			static latin_index_client* trackClient = new service_impl_single_t<latin_index_client>(false);
+			static latin_index_client* albumClient = new service_impl_single_t<latin_index_client>(true);
+			metadb_index_manager* api = metadb_index_manager::get().detach();
+			// Fails if the core's files holding our data are corrupted.
+			try {
+				api->add(trackClient, guid_index_track, index_retention);
+				api->add(albumClient, guid_index_album, index_retention);
+			} catch (std::exception const& e) {
+				api->remove(guid_index_track);
+				api->remove(guid_index_album);
+				FB2K_console_formatter() << "[latinize] metadb index unavailable, using the cache file: " << e;
+				return;
+			}
+			api->dispatch_global_refresh();
+			m_api = api;
+		}
+
+		bool get_track(metadb_index_hash hash, latin_record& out) const {
+			mem_block_container_impl blob;
+			m_api->get_user_data(guid_index_track, hash, blob);
+			if (blob.get_size() == 0) return false;
+			try {
+				stream_reader_formatter_simple_ref<false> reader(blob.get_ptr(), blob.get_size());
+				reader >> out.title >> out.album;
+				return true;
+			} catch (exception_io_data const&) {
+				return false;
+			}
+		}
+
+		bool get_album(metadb_index_hash hash, pfc::string8& out) const {
+			mem_block_container_impl blob;
+			m_api->get_user_data(guid_index_album, hash, blob);
+			if (blob.get_size() == 0) return false;
+			try {
+				stream_reader_formatter_simple_ref<false> reader(blob.get_ptr(), blob.get_size());
+				reader >> out;
+				return true;
+			} catch (exception_io_data const&) {
+				return false;
+			}
+		}
+
+		void set_track(metadb_index_hash hash, const latin_record& rec) {
+			stream_writer_formatter_simple<false> writer;
+			writer << rec.title << rec.album;
+			m_api->set_user_data(guid_index_track, hash, writer.m_buffer.get_ptr(), writer.m_buffer.get_size());
+		}
+
+		void set_album(metadb_index_hash hash, const pfc::string8& album) {
+			stream_writer_formatter_simple<false> writer;
+			writer << album;
+			m_api->set_user_data(guid_index_album, hash, writer.m_buffer.get_ptr(), writer.m_buffer.get_size());
+		}
+
+		// Empty user data removes the record.
+		void remove(bool is_track, metadb_index_hash hash) {
+			m_api->set_user_data(is_track ? guid_index_track : guid_index_album, hash, nullptr, 0);
+		}
+
+		bool is_empty() const {
+			pfc::list_t<metadb_index_hash> hashes;
+			m_api->get_all_hashes(guid_index_track, hashes);
+			if (hashes.get_count() > 0) return false;
+			m_api->get_all_hashes(guid_index_album, hashes);
+			return hashes.get_count() == 0;
+		}
+
+		void enumerate(pfc::list_t<foo_latinize::cache_entry>& out) const {
+			pfc::list_t<metadb_index_hash> hashes;
+			m_api->get_all_hashes(guid_index_track, hashes);
+			for (t_size i = 0; i < hashes.get_count(); ++i) {
+				foo_latinize::cache_entry e;
+				latin_record rec;
+				if (!get_track(hashes[i], rec)) continue;
+				e.is_track = true;
+				e.hash = hashes[i];
+				e.title = rec.title;
+				e.album = rec.album;
+				out.add_item(e);
+			}
+			hashes.remove_all();
+			m_api->get_all_hashes(guid_index_album, hashes);
+			for (t_size i = 0; i < hashes.get_count(); ++i) {
+				foo_latinize::cache_entry e;
+				if (!get_album(hashes[i], e.album)) continue;
+				e.is_track = false;
+				e.hash = hashes[i];
+				out.add_item(e);
+			}
+		}
+
+		// Writes many records at once; uses a single core transaction when the
+		// core supports it. Empty title and album remove a record.
+		void write_all(const pfc::list_t<foo_latinize::cache_entry>& entries) {
+			metadb_index_transaction::ptr transaction;
+			metadb_index_manager_v2::ptr v2;
+			if (m_api->service_query_t(v2)) transaction = v2->begin_transaction();
+			for (t_size i = 0; i < entries.get_count(); ++i) {
+				const auto& e = entries[i];
+				const GUID& index = e.is_track ? guid_index_track : guid_index_album;
+				stream_writer_formatter_simple<false> writer;
+				if (e.is_track) writer << e.title << e.album;
+				else writer << e.album;
+				const bool erase = e.title.length() == 0 && e.album.length() == 0;
+				const void* data = erase ? nullptr : writer.m_buffer.get_ptr();
+				const size_t size = erase ? 0 : writer.m_buffer.get_size();
+				if (transaction.is_valid()) transaction->set_user_data(index, e.hash, data, size);
+				else m_api->set_user_data(index, e.hash, data, size);
+			}
+			if (transaction.is_valid()) transaction->commit();
+		}
+
+		// Refreshes every item whose key is listed, including items that were
+		// not part of the run but share an album key.
+		void dispatch_refresh(const pfc::list_t<metadb_index_hash>& tracks, const pfc::list_t<metadb_index_hash>& albums) {
+			if (tracks.get_count() > 0) m_api->dispatch_refresh(guid_index_track, tracks);
+			if (albums.get_count() > 0) m_api->dispatch_refresh(guid_index_album, albums);
+		}
+
+	private:
+		metadb_index_manager* m_api = nullptr;
+	};
+
+	static latin_index_store g_index;
+
+	// Read-only bytes of the DB file. Local files are memory-mapped so only the
+	// pages actually touched by lookups become resident; anything else (or a
+	// failed mapping) is read into a heap block. Mapped files stay writable
+	// and deletable (share mode): log records are appended in place, and a
+	// compacted file is renamed over the old one, whose view stays valid until
+	// the last snapshot holding it goes away.
+	class latin_file_view {
+	public:
+		latin_file_view() = default;
+		latin_file_view(const latin_file_view&) = delete;
+		latin_file_view& operator=(const latin_file_view&) = delete;
+		~latin_file_view() { close(); }
+
+		const t_uint8* data() const { return m_data; }
+		size_t size() const { return m_size; }
+
+		void close() {
+#ifdef _WIN32
+			if (m_mapping != NULL) {
+				UnmapViewOfFile(m_data);
+				CloseHandle(m_mapping);
+				m_mapping = NULL;
+			}
+#else
+			if (m_mapped) {
+				munmap(const_cast<t_uint8*>(m_data), m_size);
+				m_mapped = false;
+			}
+#endif
+			m_heap.set_size(0);
+			m_data = nullptr;
+			m_size = 0;
+		}
+
+		// Takes ownership of an in-memory image (freshly read or compacted).
+		void adopt(pfc::array_t<t_uint8>& bytes) {
+			close();
+			m_heap = std::move(bytes);
+			m_data = m_heap.get_ptr();
+			m_size = m_heap.get_size();
+		}
+
+		// Maps a native filesystem path; returns false if that is not possible.
+		bool map(const char* nativePath) {
+			close();
+#ifdef _WIN32
+			HANDLE file = CreateFileW(pfc::stringcvt::string_wide_from_utf8(nativePath), GENERIC_READ,
+				FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			if (file == INVALID_HANDLE_VALUE) return false;
+			LARGE_INTEGER size = {};
+			HANDLE mapping = NULL;
+			if (GetFileSizeEx(file, &size) && size.QuadPart > 0 && (t_uint64)size.QuadPart <= SIZE_MAX) {
+				mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+			}
+			// The mapping keeps its own reference to the file.
+			CloseHandle(file);
+			if (mapping == NULL) return false;
+			const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			if (view == nullptr) {
+				CloseHandle(mapping);
+				return false;
+			}
+			m_mapping = mapping;
+			m_data = (const t_uint8*)view;
+			m_size = (size_t)size.QuadPart;
+			return true;
+#else
+			const int fd = ::open(nativePath, O_RDONLY);
+			if (fd < 0) return false;
+			struct stat st = {};
+			void* view = MAP_FAILED;
+			if (fstat(fd, &st) == 0 && st.st_size > 0) {
+				view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+			}
+			::close(fd);
+			if (view == MAP_FAILED) return false;
+			m_mapped = true;
+			m_data = (const t_uint8*)view;
+			m_size = (size_t)st.st_size;
+			return true;
+#endif
+		}
+
+	private:
+		const t_uint8* m_data = nullptr;
+		size_t m_size = 0;
+		pfc::array_t<t_uint8> m_heap;
+#ifdef _WIN32
+		HANDLE m_mapping = NULL;
+#else
+		bool m_mapped = false;
+#endif
+	};
+
+	// Immutable base snapshot (FBLT v4), searched in place:
+	// - header: "FBLT", version, track count, album count, blob size, key scheme,
+	//   text count, reserved (v3 headers end after the key scheme)
+	// - track index: {hash, title offset/length, album offset/length}, sorted by hash
+	// - album index: {hash, album offset/length}, sorted by hash
+	// - text index (v4): {hash, text offset/length}, sorted by hash
+	// - blob: NUL-terminated UTF-8 strings, deduplicated; offset 0 is ""
+	// All fields are little-endian, which is also the in-memory layout on every
+	// platform foobar2000 runs on, so the index is used without decoding.
+	class latin_image {
+	public:
+		struct track_entry {
+			t_uint64 hash;
+			t_uint32 titleOffset;
+			t_uint32 titleLength;
+			t_uint32 albumOffset;
+			t_uint32 albumLength;
+		};
+		struct album_entry {
+			t_uint64 hash;
+			t_uint32 offset;
+			t_uint32 length;
+		};
+		static_assert(sizeof(track_entry) == 24 && sizeof(album_entry) == 16, "FBLT index layout");
+
+		// Keeps the indexes that follow 8-byte aligned.
+		static constexpr t_uint32 header_size_v3 = 24;
+		static constexpr t_uint32 header_size = 32;
+
+		void reset() {
+			m_tracks = nullptr;
+			m_albums = nullptr;
+			m_texts = nullptr;
+			m_trackCount = 0;
+			m_albumCount = 0;
+			m_textCount = 0;
+			m_blob = nullptr;
+			m_blobSize = 0;
+			m_keyScheme = key_md5;
+		}
+
+		// Binds to a v3 or v4 image at the start of `data`; returns the image
+		// size (where the append log starts), or 0 if the header is inconsistent.
+		size_t bind(const t_uint8* data, size_t size) {
+			reset();
+			if (size < header_size_v3) return 0;
+			t_uint32 header[8] = {};
+			memcpy(header, data, header_size_v3);
+			const bool v4 = header[1] >= 4;
+			if (v4) {
+				if (size < header_size) return 0;
+				memcpy(header, data, header_size);
+			}
+			const size_t headerSize = v4 ? header_size : header_size_v3;
+			const t_uint64 trackBytes = (t_uint64)header[2] * sizeof(track_entry);
+			const t_uint64 albumBytes = (t_uint64)header[3] * sizeof(album_entry);
+			const t_uint64 textBytes = (t_uint64)header[6] * sizeof(album_entry);
+			const t_uint64 total = headerSize + trackBytes + albumBytes + textBytes + header[4];
+			if (total > size || header[4] == 0) return 0;
+			m_tracks = (const track_entry*)(data + headerSize);
+			m_albums = (const album_entry*)(data + headerSize + trackBytes);
+			m_texts = (const album_entry*)(data + headerSize + trackBytes + albumBytes);
+			m_blob = (const char*)(data + headerSize + trackBytes + albumBytes + textBytes);
+			m_trackCount = header[2];
+			m_albumCount = header[3];
+			m_textCount = header[6];
+			m_blobSize = header[4];
+			m_keyScheme = header[5];
+			return (size_t)total;
+		}
+
+		t_uint32 key_scheme() const { return m_keyScheme; }
+		t_uint32 track_count() const { return m_trackCount; }
+		t_uint32 album_count() const { return m_albumCount; }
+		t_uint32 text_count() const { return m_textCount; }
+		const track_entry& track_at(t_uint32 i) const { return m_tracks[i]; }
+		const album_entry& album_at(t_uint32 i) const { return m_albums[i]; }
+		const album_entry& text_at(t_uint32 i) const { return m_texts[i]; }
+
+		const track_entry* find_track(metadb_index_hash hash) const {
+			const track_entry* end = m_tracks + m_trackCount;
+			const track_entry* it = std::lower_bound(m_tracks, end, hash,
+				[](const track_entry& e, metadb_index_hash h) { return e.hash < h; });
+			return (it != end && it->hash == hash) ? it : nullptr;
+		}
+
+		const album_entry* find_album(metadb_index_hash hash) const {
+			return find_string(m_albums, m_albumCount, hash);
+		}
+
+		const album_entry* find_text(metadb_index_hash hash) const {
+			return find_string(m_texts, m_textCount, hash);
+		}
+
+		// Blob strings are bounds-checked on access rather than on load, so
+		// opening a large DB does not touch every page.
+		const char* string_at(t_uint32 offset, t_uint32 length) const {
+			if ((t_uint64)offset + length >= m_blobSize || m_blob[offset + length] != 0) return "";
+			return m_blob + offset;
+		}
+
+	private:
+		static const album_entry* find_string(const album_entry* begin, t_uint32 count, metadb_index_hash hash) {
+			const album_entry* end = begin + count;
+			const album_entry* it = std::lower_bound(begin, end, hash,
+				[](const album_entry& e, metadb_index_hash h) { return e.hash < h; });
+			return (it != end && it->hash == hash) ? it : nullptr;
+		}
+
+		const track_entry* m_tracks = nullptr;
+		const album_entry* m_albums = nullptr;
+		const album_entry* m_texts = nullptr;
+		t_uint32 m_trackCount = 0;
+		t_uint32 m_albumCount = 0;
+		t_uint32 m_textCount = 0;
+		const char* m_blob = nullptr;
+		t_uint32 m_blobSize = 0;
+		t_uint32 m_keyScheme = key_md5;
+	};
+
+	// Overlay entries shadow the image; `deleted` hides an image entry.
+	struct overlay_track {
+		latin_record rec;
+		bool deleted = false;
+	};
+	struct overlay_album {
+		pfc::string8 album;
+		bool deleted = false;
+	};
+
+	// Overlay changes published together; never modified once published, so
+	// consecutive snapshots share every layer but the newest.
+	struct overlay_layer {
+		std::unordered_map<metadb_index_hash, overlay_track> tracks;
+		std::unordered_map<metadb_index_hash, overlay_album> albums;
+
+		size_t size() const { return tracks.size() + albums.size(); }
+	};
+
+	// Text borrowed from a snapshot; valid for as long as the snapshot is held.
+	struct latin_text {
+		const char* ptr = "";
+		size_t length = 0;
+	};
+
+	// Immutable copy of the DB state published for readers that must not wait
+	// on the DB lock (title formatting runs for every visible row on every
+	// repaint, concurrently with batch writes). Holding the snapshot keeps its
+	// file view alive, so results point straight into the image or overlay.
+	// The overlay is a short stack of shared layers, newest last.
+	class latin_snapshot {
+	public:
+		// Increases with every publish; lets derived caches detect stale results.
+		t_uint64 generation() const { return m_generation; }
+
+		bool find_track(metadb_index_hash hash, latin_text& title, latin_text& album) const {
+			for (auto layer = m_layers.rbegin(); layer != m_layers.rend(); ++layer) {
+				auto it = (*layer)->tracks.find(hash);
+				if (it == (*layer)->tracks.end()) continue;
+				if (it->second.deleted) return false;
+				title = text_of(it->second.rec.title);
+				album = text_of(it->second.rec.album);
+				return true;
+			}
+			const auto* e = m_image.find_track(hash);
+			if (e == nullptr) return false;
+			title = text_of(m_image.string_at(e->titleOffset, e->titleLength), e->titleLength);
+			album = text_of(m_image.string_at(e->albumOffset, e->albumLength), e->albumLength);
+			return true;
+		}
+
+		bool find_album(metadb_index_hash hash, latin_text& album) const {
+			for (auto layer = m_layers.rbegin(); layer != m_layers.rend(); ++layer) {
+				auto it = (*layer)->albums.find(hash);
+				if (it == (*layer)->albums.end()) continue;
+				if (it->second.deleted) return false;
+				album = text_of(it->second.album);
+				return true;
+			}
+			const auto* e = m_image.find_album(hash);
+			if (e == nullptr) return false;
+			album = text_of(m_image.string_at(e->offset, e->length), e->length);
+			return true;
+		}
+
+	private:
+		friend class latin_db;
+
+		static latin_text text_of(const pfc::string8& s) {
+			latin_text t;
+			t.ptr = s.c_str();
+			t.length = s.length();
+			return t;
+		}
+		// string_at() yields "" for out-of-range entries; keep the length consistent.
+		static latin_text text_of(const char* s, t_uint32 length) {
+			latin_text t;
+			t.ptr = s;
+			t.length = (*s != 0) ? length : 0;
+			return t;
+		}
+
+		t_uint64 m_generation = 0;
+		std::shared_ptr<latin_file_view> m_view;
+		latin_image m_image;
+		std::vector<std::shared_ptr<const overlay_layer>> m_layers;
+	};
+
+	// Why a track could not be latinized; kept in the negative tier of latin_db.
+	enum negative_reason : t_uint32 {
+		negative_failed = 1,	// no usable answer: request error, missing or unparsable record
+		negative_empty = 2,		// answered, but nothing was left after sanitizing
+	};
+
+	struct negative_entry {
+		t_uint32 reason = negative_failed;
+		t_uint32 attempts = 0;
+		t_filetimestamp expires = 0;
 	};
 
 	// Simple persistent cache:
 	// - tracks: keyed by hash of artist/title/album
 	// - albums: keyed by hash of album
+	// - texts: shared strings, keyed by hash_source_text() of a title or album
 	// This cache is saved to a local DB file in the profile directory.
+	//
+	// File format (FBLT v4):
+	// - base image: sorted, memory-mappable index + string blob (see latin_image)
+	// - append log: set/delete records written after the image, replayed on load
+	// Lookups consult a small overlay (changes since the image was written, incl.
+	// deletions) and then binary-search the image, so opening the DB neither
+	// parses nor allocates per entry.
+	// Saving appends only the records changed since the last save; the image is
+	// rebuilt (compacted) when the log outgrows it, and only from callers that
+	// allow it (batch workers, shutdown), never from UI edits.
+	// v1/v2 files are read into the overlay and upgraded on the next save;
+	// v3 images (no text table) are used as they are and rewritten as v4.
+	//
+	// Texts are not tied to any track, so they always stay in this file, also
+	// with metadb index storage: index retention and album deletes never
+	// touch them.
+	//
+	// Writers (batch runs, cache page) work on the live state under m_mutex.
+	// Display readers use read(), an immutable snapshot swapped in atomically
+	// whenever changes are saved, so they never contend with a running batch.
+	//
+	// Negative tier: tracks that could not be latinized, with the reason, the
+	// number of attempts and an expiry, so repeat runs skip them until then.
+	// It lives in a small side file (DB path + ".neg", rewritten whole when
+	// changed) for both storage modes and is not part of the FBLT format.
 	class latin_db {
 	public:
 		void ensure_loaded() {
+			if (load_if_needed()) {
+				// Outside the lock: refreshing re-enters the field provider.
+				static_api_ptr_t<metadb_index_manager>()->dispatch_global_refresh();
+			}
+		}
+
+		// Returns true if entries were migrated into the metadb index.
+		bool load_if_needed() {
 			std::lock_guard<std::mutex> lock(m_mutex);
 			const auto path = foo_latinize::get_db_path();
-			if (m_loaded && m_path == path) return;
+			if (m_loaded && m_path == path) {
+				adopt_key_scheme_locked();
+				return false;
+			}
 			m_path = path;
 			m_loaded = true;
-			m_dirty = false;
-			m_tracks.clear();
-			m_albums.clear();
+			reset_view_locked();
+			clear_overlay_locked();
+			m_pending.clear();
+			m_rewrite = false;
+			m_readOnly = false;
+			m_baseBytes = 0;
+			m_logBytes = 0;
+			m_keyScheme = key_md5;
+			m_negative.clear();
+			m_negativeDirty = false;
 			load_locked();
+			load_negative_locked();
+			adopt_key_scheme_locked();
+			// Index storage is pinned to MD5 keys.
+			g_keyScheme = g_index.active() ? (t_uint32)key_md5 : m_keyScheme;
+			const bool migrated = g_index.active() && migrate_to_index_locked();
+			m_stale = true;
+			publish_locked();
+			return migrated;
+		}
+
+		// With index storage, refreshes the items whose keys were written since
+		// the last call; returns false (nothing done) with file storage.
+		bool dispatch_index_refresh() {
+			if (!g_index.active()) return false;
+			pfc::list_t<metadb_index_hash> tracks, albums;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				std::swap(tracks, m_refreshTracks);
+				std::swap(albums, m_refreshAlbums);
+			}
+			g_index.dispatch_refresh(tracks, albums);
+			return true;
+		}
+
+		// Lock-free read access; null until the DB has been loaded.
+		std::shared_ptr<const latin_snapshot> read() const {
+			return std::atomic_load(&m_published);
 		}
 
 		bool get_track(metadb_index_hash hash, latin_record& out) {
 			std::lock_guard<std::mutex> lock(m_mutex);
-			auto it = m_tracks.find(hash);
-			if (it == m_tracks.end()) return false;
-			out = it->second;
-			return true;
+			return find_track_locked(hash, out);
 		}
 
 		bool get_album(metadb_index_hash hash, pfc::string8& out) {
 			std::lock_guard<std::mutex> lock(m_mutex);
-			auto it = m_albums.find(hash);
-			if (it == m_albums.end()) return false;
-			out = it->second;
-			return true;
+			return find_album_locked(hash, out);
 		}
 
 		void set_track(metadb_index_hash hash, const latin_record& rec) {
 			std::lock_guard<std::mutex> lock(m_mutex);
-			auto it = m_tracks.find(hash);
-			if (it != m_tracks.end() && it->second.title == rec.title && it->second.album == rec.album) return;
-			m_tracks[hash] = rec;
-			m_dirty = true;
+			put_track_locked(hash, rec);
 		}
 
 		void set_album(metadb_index_hash hash, const pfc::string8& album) {
 			std::lock_guard<std::mutex> lock(m_mutex);
-			auto it = m_albums.find(hash);
-			if (it != m_albums.end() && it->second == album) return;
-			m_albums[hash] = album;
-			m_dirty = true;
+			put_album_locked(hash, album);
 		}
 
-		void save_if_dirty() {
+		bool get_text(metadb_index_hash hash, pfc::string8& out) {
 			std::lock_guard<std::mutex> lock(m_mutex);
-			if (!m_dirty) return;
-			save_locked();
-			m_dirty = false;
+			return find_text_locked(hash, out);
 		}
 
-		void snapshot(pfc::list_t<foo_latinize::cache_entry>& out) {
+		// The first answer for a text wins; returns false if one was there.
+		bool add_text(metadb_index_hash hash, const pfc::string8& text) {
 			std::lock_guard<std::mutex> lock(m_mutex);
-			out.remove_all();
-			out.prealloc((t_size)(m_tracks.size() + m_albums.size()));
-			for (auto const& kv : m_tracks) {
-				foo_latinize::cache_entry e;
-				e.is_track = true;
-				e.hash = kv.first;
-				e.title = kv.second.title;
-				e.album = kv.second.album;
-				out.add_item(e);
+			pfc::string8 existing;
+			if (find_text_locked(hash, existing) && existing.length() > 0) return false;
+			return put_text_locked(hash, text);
+		}
+
+		// Persists pending changes. With allowCompact, a log that has outgrown
+		// the image is folded into a fresh file; otherwise changes are only
+		// appended, which keeps per-edit I/O proportional to the edit.
+		void save_if_dirty(bool allowCompact = true) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			publish_locked();
+			if (m_negativeDirty) save_negative_locked();
+			if (m_readOnly) return;
+			if (!m_rewrite && m_pending.empty()) {
+				if (!allowCompact || !compaction_due_locked()) return;
 			}
-			for (auto const& kv : m_albums) {
-				foo_latinize::cache_entry e;
-				e.is_track = false;
-				e.hash = kv.first;
-				e.album = kv.second;
-				out.add_item(e);
+			if (m_rewrite || (allowCompact && compaction_due_locked())) {
+				save_locked();
+			} else if (!append_locked()) {
+				// Could not append (file missing or unwritable); fall back to a full write.
+				save_locked();
 			}
 		}
 
+		void snapshot(pfc::list_t<foo_latinize::cache_entry>& out) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			out.remove_all();
+			if (g_index.active()) g_index.enumerate(out);
+			else file_entries_locked(out);
+			text_entries_locked(out);
+			negative_entries_locked(out);
+		}
+
+		// True if the track failed before and its entry has not expired yet.
+		// A period of 0 retries everything, whatever was recorded before.
+		bool is_known_failure(metadb_index_hash hash) {
+			if (foo_latinize::cfg_negative_ttl.get() == 0) return false;
+			std::lock_guard<std::mutex> lock(m_mutex);
+			auto it = m_negative.find(hash);
+			return it != m_negative.end() && it->second.expires > filetimestamp_from_system_timer();
+		}
+
+		// Records another failed attempt. Each one doubles the wait, up to
+		// eight times the configured period; request failures start at an
+		// hour, as they are often transient (network, quota).
+		void note_failure(metadb_index_hash hash, negative_reason reason) {
+			const t_filetimestamp ttl = (t_filetimestamp)foo_latinize::cfg_negative_ttl.get() * system_time_periods::day;
+			if (ttl == 0) return;
+			std::lock_guard<std::mutex> lock(m_mutex);
+			negative_entry& e = m_negative[hash];
+			if (e.reason != reason) e.attempts = 0;
+			e.reason = reason;
+			if (e.attempts < UINT32_MAX) ++e.attempts;
+			const unsigned shift = pfc::min_t<t_uint32>(e.attempts - 1, 3);
+			const t_filetimestamp base = reason == negative_failed ? pfc::min_t<t_filetimestamp>(system_time_periods::hour, ttl) : ttl;
+			e.expires = filetimestamp_from_system_timer() + pfc::min_t<t_filetimestamp>(base << shift, ttl << 3);
+			m_negativeDirty = true;
+		}
+
+		bool delete_negative(metadb_index_hash hash) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_negative.erase(hash) == 0) return false;
+			m_negativeDirty = true;
+			return true;
+		}
+
 		bool update_entry(const foo_latinize::cache_entry& entry) {
 			std::lock_guard<std::mutex> lock(m_mutex);
-			if (entry.is_track) {
+			if (entry.is_text) {
+				const pfc::string8 text = sanitize_latin(entry.title.c_str());
+				return text.length() > 0 ? put_text_locked(entry.hash, text) : delete_text_locked(entry.hash);
+			} else if (entry.is_track) {
 				latin_record rec;
 				rec.title = sanitize_latin(entry.title.c_str());
 				rec.album = sanitize_latin(entry.album.c_str());
-				auto it = m_tracks.find(entry.hash);
-				if (it != m_tracks.end() && it->second.title == rec.title && it->second.album == rec.album) return false;
-				m_tracks[entry.hash] = rec;
-				m_dirty = true;
-				return true;
+				// Saving a skipped track supplies its result by hand.
+				const bool wasNegative = entry.is_negative && m_negative.erase(entry.hash) > 0;
+				if (wasNegative) m_negativeDirty = true;
+				if (rec.title.length() == 0 && rec.album.length() == 0) return wasNegative;
+				return put_track_locked(entry.hash, rec) || wasNegative;
 			} else {
-				pfc::string8 album = sanitize_latin(entry.album.c_str());
-				auto it = m_albums.find(entry.hash);
-				if (it != m_albums.end() && it->second == album) return false;
-				m_albums[entry.hash] = album;
-				m_dirty = true;
-				return true;
+				return put_album_locked(entry.hash, sanitize_latin(entry.album.c_str()));
 			}
 		}
 
 		bool delete_entry(bool is_track, metadb_index_hash hash) {
 			std::lock_guard<std::mutex> lock(m_mutex);
+			if (g_index.active()) {
+				latin_record existing;
+				pfc::string8 album;
+				if (is_track ? !g_index.get_track(hash, existing) : !g_index.get_album(hash, album)) return false;
+				g_index.remove(is_track, hash);
+				(is_track ? m_refreshTracks : m_refreshAlbums).add_item(hash);
+				m_stale = true;
+				return true;
+			}
 			if (is_track) {
-				auto it = m_tracks.find(hash);
-				if (it == m_tracks.end()) return false;
-				m_tracks.erase(it);
+				latin_record existing;
+				if (!find_track_locked(hash, existing)) return false;
+				set_overlay_locked(hash, overlay_track{ latin_record(), true });
 			} else {
-				auto it = m_albums.find(hash);
-				if (it == m_albums.end()) return false;
-				m_albums.erase(it);
+				pfc::string8 existing;
+				if (!find_album_locked(hash, existing)) return false;
+				set_overlay_locked(hash, overlay_album{ pfc::string8(), true });
 			}
-			m_dirty = true;
+			log_op op;
+			op.type = is_track ? op_delete_track : op_delete_album;
+			op.hash = hash;
+			m_pending.push_back(std::move(op));
+			m_stale = true;
 			return true;
 		}
 
+		bool delete_text(metadb_index_hash hash) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return delete_text_locked(hash);
+		}
+
 		void clear_all() {
 			std::lock_guard<std::mutex> lock(m_mutex);
-			if (m_tracks.empty() && m_albums.empty()) return;
-			m_tracks.clear();
-			m_albums.clear();
-			m_dirty = true;
+			if (!m_negative.empty()) {
+				m_negative.clear();
+				m_negativeDirty = true;
+			}
+			// Index storage clears the file too, so it is not migrated again.
+			if (g_index.active()) clear_index_locked();
+			if (m_readOnly) {
+				// Clearing is the user's go-ahead to replace a newer build's file.
+				m_readOnly = false;
+				m_rewrite = true;
+			}
+			if (is_empty_locked()) return;
+			reset_view_locked();
+			clear_overlay_locked();
+			adopt_key_scheme_locked();
+			m_stale = true;
+			// An empty image is cheaper than a log of deletes.
+			m_pending.clear();
+			m_rewrite = true;
 		}
 
 	private:
-		void load_locked() {
-			abort_callback_dummy abort;
-			file::ptr f;
-			try {
-				filesystem::g_open_read(f, m_path, abort);
-			} catch (exception_io_not_found const&) {
-				FB2K_console_formatter() << "[latinize] DB not found: " << m_path;
-				return;
-			} catch (exception_io const&) {
-				FB2K_console_formatter() << "[latinize] Failed to open DB for read: " << m_path;
-				return;
-			}
+		static constexpr t_uint32 file_magic = 0x544C4246; // "FBLT"
+		static constexpr t_uint32 file_version = 4;
+		// First version whose base is a latin_image; earlier ones are parsed.
+		static constexpr t_uint32 image_version = 3;
+		static constexpr t_uint32 negative_magic = 0x4E4C4246; // "FBLN"
+		static constexpr t_uint32 negative_version = 1;
+		// Compact once the log is larger than half the image (and not tiny).
+		static constexpr t_uint64 compact_min_log_bytes = 64 * 1024;
 
-			try {
-				const t_uint32 magic = f->read_lendian_t<t_uint32>(abort);
-				const t_uint32 version = f->read_lendian_t<t_uint32>(abort);
-				if (magic != 0x544C4246 || version != 1) return; // "FBLT"
+		enum : t_uint8 {
+			op_set_track = 1,
+			op_set_album = 2,
+			op_delete_track = 3,
+			op_delete_album = 4,
+			op_set_text = 5,
+			op_delete_text = 6,
+		};
 
-				const t_uint32 trackCount = f->read_lendian_t<t_uint32>(abort);
-				const t_uint32 albumCount = f->read_lendian_t<t_uint32>(abort);
+		// Change not yet appended to the file.
+		struct log_op {
+			t_uint8 type = 0;
+			metadb_index_hash hash = 0;
+			pfc::string8 title;
+			pfc::string8 album;
+		};
 
-				for (t_uint32 i = 0; i < trackCount; ++i) {
-					const metadb_index_hash hash = f->read_lendian_t<metadb_index_hash>(abort);
-					latin_record rec;
-					f->read_string(rec.title, abort);
-					f->read_string(rec.album, abort);
-					m_tracks.emplace(hash, rec);
-				}
-				for (t_uint32 i = 0; i < albumCount; ++i) {
-					const metadb_index_hash hash = f->read_lendian_t<metadb_index_hash>(abort);
-					pfc::string8 album;
-					f->read_string(album, abort);
-					m_albums.emplace(hash, album);
-				}
-			} catch (exception_io const&) {
-				m_tracks.clear();
-				m_albums.clear();
-				FB2K_console_formatter() << "[latinize] Failed to read DB (corrupt?): " << m_path;
+		bool find_track_locked(metadb_index_hash hash, latin_record& out) const {
+			if (g_index.active()) return g_index.get_track(hash, out);
+			auto it = m_tracks.find(hash);
+			if (it != m_tracks.end()) {
+				if (it->second.deleted) return false;
+				out = it->second.rec;
+				return true;
 			}
+			const auto* e = m_image.find_track(hash);
+			if (e == nullptr) return false;
+			out.title = m_image.string_at(e->titleOffset, e->titleLength);
+			out.album = m_image.string_at(e->albumOffset, e->albumLength);
+			return true;
 		}
 
-		void save_locked() {
-			abort_callback_dummy abort;
-			try {
-				pfc::string8 dir = m_path;
-				dir.truncate(dir.scan_filename());
-				if (dir.length() > 0) {
-					try {
-						filesystem::g_create_directory(dir, abort);
-					} catch (exception_io const&) {
-						// Directory may already exist or be provided by user; try to write anyway.
-					}
-				}
+		bool find_album_locked(metadb_index_hash hash, pfc::string8& out) const {
+			if (g_index.active()) return g_index.get_album(hash, out);
+			auto it = m_albums.find(hash);
+			if (it != m_albums.end()) {
+				if (it->second.deleted) return false;
+				out = it->second.album;
+				return true;
+			}
+			const auto* e = m_image.find_album(hash);
+			if (e == nullptr) return false;
+			out = m_image.string_at(e->offset, e->length);
+			return true;
+		}
 
+		// Texts always come from the file (see the class comment).
+		bool find_text_locked(metadb_index_hash hash, pfc::string8& out) const {
+			auto it = m_texts.find(hash);
+			if (it != m_texts.end()) {
+				if (it->second.deleted) return false;
+				out = it->second.album;
+				return true;
+			}
+			const auto* e = m_image.find_text(hash);
+			if (e == nullptr) return false;
+			out = m_image.string_at(e->offset, e->length);
+			return true;
+		}
+
+		bool put_track_locked(metadb_index_hash hash, const latin_record& rec) {
+			// A result supersedes an earlier failure.
+			if (m_negative.erase(hash) > 0) m_negativeDirty = true;
+			latin_record existing;
+			if (find_track_locked(hash, existing) && existing.title == rec.title && existing.album == rec.album) return false;
+			if (g_index.active()) {
+				g_index.set_track(hash, rec);
+				m_refreshTracks.add_item(hash);
+				m_stale = true;
+				return true;
+			}
+			set_overlay_locked(hash, overlay_track{ rec, false });
+			log_op op;
+			op.type = op_set_track;
+			op.hash = hash;
+			op.title = rec.title;
+			op.album = rec.album;
+			m_pending.push_back(std::move(op));
+			m_stale = true;
+			return true;
+		}
+
+		bool put_album_locked(metadb_index_hash hash, const pfc::string8& album) {
+			pfc::string8 existing;
+			if (find_album_locked(hash, existing) && existing == album) return false;
+			if (g_index.active()) {
+				g_index.set_album(hash, album);
+				m_refreshAlbums.add_item(hash);
+				m_stale = true;
+				return true;
+			}
+			set_overlay_locked(hash, overlay_album{ album, false });
+			log_op op;
+			op.type = op_set_album;
+			op.hash = hash;
+			op.album = album;
+			m_pending.push_back(std::move(op));
+			m_stale = true;
+			return true;
+		}
+
+		bool put_text_locked(metadb_index_hash hash, const pfc::string8& text) {
+			pfc::string8 existing;
+			if (find_text_locked(hash, existing) && existing == text) return false;
+			m_texts[hash] = overlay_album{ text, false };
+			log_op op;
+			op.type = op_set_text;
+			op.hash = hash;
+			op.album = text;
+			m_pending.push_back(std::move(op));
+			return true;
+		}
+
+		bool delete_text_locked(metadb_index_hash hash) {
+			pfc::string8 existing;
+			if (!find_text_locked(hash, existing)) return false;
+			m_texts[hash] = overlay_album{ pfc::string8(), true };
+			log_op op;
+			op.type = op_delete_text;
+			op.hash = hash;
+			m_pending.push_back(std::move(op));
+			return true;
+		}
+
+		bool is_empty_locked() const {
+			return m_image.track_count() == 0 && m_image.album_count() == 0 && m_image.text_count() == 0
+				&& m_tracks.empty() && m_albums.empty() && m_texts.empty();
+		}
+
+		// An empty DB switches to the configured key scheme; a populated one
+		// keeps the scheme its keys were made with.
+		void adopt_key_scheme_locked() {
+			const t_uint32 wanted = foo_latinize::cfg_fast_keys.get() ? key_xxh64 : key_md5;
+			if (wanted == m_keyScheme) return;
+			if (!is_empty_locked()) return;
+			m_keyScheme = wanted;
+			g_keyScheme = wanted;
+			// The header carries the scheme.
+			m_rewrite = true;
+		}
+
+		void file_entries_locked(pfc::list_t<foo_latinize::cache_entry>& out) const {
+			out.prealloc((t_size)(m_image.track_count() + m_image.album_count() + m_tracks.size() + m_albums.size()));
+			for (t_uint32 i = 0; i < m_image.track_count(); ++i) {
+				const auto& t = m_image.track_at(i);
+				if (m_tracks.count(t.hash) > 0) continue;
+				foo_latinize::cache_entry e;
+				e.is_track = true;
+				e.hash = t.hash;
+				e.title = m_image.string_at(t.titleOffset, t.titleLength);
+				e.album = m_image.string_at(t.albumOffset, t.albumLength);
+				out.add_item(e);
+			}
+			for (auto const& kv : m_tracks) {
+				if (kv.second.deleted) continue;
+				foo_latinize::cache_entry e;
+				e.is_track = true;
+				e.hash = kv.first;
+				e.title = kv.second.rec.title;
+				e.album = kv.second.rec.album;
+				out.add_item(e);
+			}
+			for (t_uint32 i = 0; i < m_image.album_count(); ++i) {
+				const auto& a = m_image.album_at(i);
+				if (m_albums.count(a.hash) > 0) continue;
+				foo_latinize::cache_entry e;
+				e.is_track = false;
+				e.hash = a.hash;
+				e.album = m_image.string_at(a.offset, a.length);
+				out.add_item(e);
+			}
+			for (auto const& kv : m_albums) {
+				if (kv.second.deleted) continue;
+				foo_latinize::cache_entry e;
+				e.is_track = false;
+				e.hash = kv.first;
+				e.album = kv.second.album;
+				out.add_item(e);
+			}
+		}
+
+		// Texts are listed with their value in `title`.
+		void text_entries_locked(pfc::list_t<foo_latinize::cache_entry>& out) const {
+			for (t_uint32 i = 0; i < m_image.text_count(); ++i) {
+				const auto& t = m_image.text_at(i);
+				if (m_texts.count(t.hash) > 0) continue;
+				foo_latinize::cache_entry e;
+				e.is_text = true;
+				e.hash = t.hash;
+				e.title = m_image.string_at(t.offset, t.length);
+				out.add_item(e);
+			}
+			for (auto const& kv : m_texts) {
+				if (kv.second.deleted) continue;
+				foo_latinize::cache_entry e;
+				e.is_text = true;
+				e.hash = kv.first;
+				e.title = kv.second.album;
+				out.add_item(e);
+			}
+		}
+
+		void negative_entries_locked(pfc::list_t<foo_latinize::cache_entry>& out) const {
+			const t_filetimestamp now = filetimestamp_from_system_timer();
+			for (auto const& kv : m_negative) {
+				const negative_entry& n = kv.second;
+				foo_latinize::cache_entry e;
+				e.is_track = true;
+				e.is_negative = true;
+				e.hash = kv.first;
+				e.status << (n.reason == negative_empty ? "empty result" : "request failed")
+					<< ", " << n.attempts << (n.attempts == 1 ? " attempt" : " attempts");
+				if (n.expires > now) e.status << ", skipped until " << format_filetimestamp(n.expires);
+				else e.status << ", retried on the next run";
+				out.add_item(e);
+			}
+		}
+
+		pfc::string8 negative_path_locked() const {
+			pfc::string8 path = m_path;
+			path << ".neg";
+			return path;
+		}
+
+		// Expired entries are kept in memory (their attempt count still
+		// matters) but not read back once expired for a whole TTL period.
+		void load_negative_locked() {
+			abort_callback_dummy abort;
+			pfc::array_t<t_uint8> bytes;
+			try {
+				file::ptr f;
+				filesystem::g_open_read(f, negative_path_locked(), abort);
+				bytes.set_size(pfc::downcast_guarded<t_size>(f->get_size_ex(abort)));
+				f->read_object(bytes.get_ptr(), bytes.get_size(), abort);
+			} catch (exception_io const&) {
+				return;   // nothing recorded yet
+			}
+			const t_filetimestamp ttl = (t_filetimestamp)foo_latinize::cfg_negative_ttl.get() * system_time_periods::day;
+			if (ttl == 0) {
+				// Retrying on every run: drop the file on the next save.
+				m_negativeDirty = true;
+				return;
+			}
+			const t_filetimestamp now = filetimestamp_from_system_timer();
+			try {
+				stream_reader_formatter_simple_ref<false> reader(bytes.get_ptr(), bytes.get_size());
+				t_uint32 magic = 0, version = 0, count = 0;
+				reader >> magic >> version >> count;
+				if (magic != negative_magic || version != negative_version) return;
+				for (t_uint32 i = 0; i < count; ++i) {
+					metadb_index_hash hash = 0;
+					negative_entry e;
+					reader >> hash >> e.reason >> e.attempts >> e.expires;
+					if (e.expires + ttl > now) m_negative[hash] = e;
+				}
+			} catch (exception_io const&) {
+				// Keep what was read; the file is rewritten on the next save.
+				m_negativeDirty = true;
+			}
+		}
+
+		void save_negative_locked() {
+			abort_callback_dummy abort;
+			const pfc::string8 path = negative_path_locked();
+			m_negativeDirty = false;
+			try {
+				if (m_negative.empty()) {
+					if (filesystem::g_exists(path, abort)) filesystem::g_remove(path, abort);
+					return;
+				}
+				stream_writer_formatter_simple<false> writer;
+				writer << negative_magic << negative_version << (t_uint32)m_negative.size();
+				for (auto const& kv : m_negative) {
+					writer << kv.first << kv.second.reason << kv.second.attempts << kv.second.expires;
+				}
+				file::ptr f;
+				filesystem::g_open_write_new(f, path, abort);
+				f->write(writer.m_buffer.get_ptr(), writer.m_buffer.get_size(), abort);
+				f->commit(abort);
+			} catch (exception_io const&) {
+				m_negativeDirty = true;
+				FB2K_console_formatter() << "[latinize] Failed to save skipped items: " << path;
+			}
+		}
+
+		// One-time copy of the file's entries into an empty metadb index. The
+		// file is left as it is, as a backup and for switching back.
+		bool migrate_to_index_locked() {
+			if (m_migrated) return false;
+			m_migrated = true;
+			if (!g_index.is_empty()) return false;
+			pfc::list_t<foo_latinize::cache_entry> entries;
+			file_entries_locked(entries);
+			if (entries.get_count() == 0) return false;
+			if (m_keyScheme != key_md5) {
+				FB2K_console_formatter() << "[latinize] Cache file uses XXH64 keys and cannot be copied to the metadb index; clear it or disable fast keys first";
+				return false;
+			}
+			g_index.write_all(entries);
+			FB2K_console_formatter() << "[latinize] Copied " << entries.get_count() << " cache entries to the metadb index";
+			return true;
+		}
+
+		void clear_index_locked() {
+			pfc::list_t<foo_latinize::cache_entry> entries;
+			g_index.enumerate(entries);
+			for (t_size i = 0; i < entries.get_count(); ++i) {
+				auto& e = entries[i];
+				(e.is_track ? m_refreshTracks : m_refreshAlbums).add_item(e.hash);
+				e.title.reset();
+				e.album.reset();
+			}
+			if (entries.get_count() == 0) return;
+			g_index.write_all(entries);
+			m_stale = true;
+		}
+
+		void reset_view_locked() {
+			m_image.reset();
+			// Published snapshots may still hold the old view.
+			m_view = std::make_shared<latin_file_view>();
+		}
+
+		// Every overlay change goes to the live maps and to the unpublished layer.
+		void set_overlay_locked(metadb_index_hash hash, const overlay_track& t) {
+			m_tracks[hash] = t;
+			m_delta.tracks[hash] = t;
+		}
+		void set_overlay_locked(metadb_index_hash hash, const overlay_album& a) {
+			m_albums[hash] = a;
+			m_delta.albums[hash] = a;
+		}
+
+		void clear_overlay_locked() {
+			m_tracks.clear();
+			m_albums.clear();
+			m_texts.clear();
+			m_layers.clear();
+			m_delta = overlay_layer();
+		}
+
+		// Hands the changes since the last publish to readers as a new layer.
+		// A layer at least as large as the one below it is merged into it, so
+		// there are O(log n) layers and each entry is copied O(log n) times
+		// over a run, however often checkpoints publish.
+		void push_layer_locked() {
+			if (m_delta.size() == 0) return;
+			auto top = std::make_shared<const overlay_layer>(std::move(m_delta));
+			m_delta = overlay_layer();
+			while (!m_layers.empty() && m_layers.back()->size() <= top->size()) {
+				auto merged = std::make_shared<overlay_layer>(*m_layers.back());
+				for (auto const& kv : top->tracks) merged->tracks[kv.first] = kv.second;
+				for (auto const& kv : top->albums) merged->albums[kv.first] = kv.second;
+				m_layers.pop_back();
+				top = std::move(merged);
+			}
+			m_layers.push_back(std::move(top));
+		}
+
+		// Publishes the live state as a new snapshot for readers. The image and
+		// all earlier layers are shared, so only the new changes are copied.
+		void publish_locked() {
+			if (!m_stale) return;
+			push_layer_locked();
+			auto snap = std::make_shared<latin_snapshot>();
+			snap->m_view = m_view;
+			snap->m_image = m_image;
+			snap->m_layers = m_layers;
+			snap->m_generation = ++m_generation;
+			std::atomic_store(&m_published, std::shared_ptr<const latin_snapshot>(std::move(snap)));
+			m_stale = false;
+		}
+
+		bool compaction_due_locked() const {
+			return m_logBytes > compact_min_log_bytes && m_logBytes > m_baseBytes / 2;
+		}
+
+		// Replays one log record into the overlay; returns false on an unknown record.
+		bool replay_locked(stream_reader_formatter_simple_ref<false>& reader) {
+			t_uint8 type = 0;
+			metadb_index_hash hash = 0;
+			reader >> type >> hash;
+			switch (type) {
+			case op_set_track: {
+				overlay_track t;
+				reader >> t.rec.title >> t.rec.album;
+				set_overlay_locked(hash, t);
+				return true;
+			}
+			case op_set_album: {
+				overlay_album a;
+				reader >> a.album;
+				set_overlay_locked(hash, a);
+				return true;
+			}
+			case op_delete_track:
+				set_overlay_locked(hash, overlay_track{ latin_record(), true });
+				return true;
+			case op_delete_album:
+				set_overlay_locked(hash, overlay_album{ pfc::string8(), true });
+				return true;
+			case op_set_text: {
+				overlay_album a;
+				reader >> a.album;
+				m_texts[hash] = a;
+				return true;
+			}
+			case op_delete_text:
+				m_texts[hash] = overlay_album{ pfc::string8(), true };
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		// v1/v2 snapshot: entries are parsed into the overlay.
+		void load_legacy_locked(stream_reader_formatter_simple_ref<false>& reader) {
+			t_uint32 trackCount = 0, albumCount = 0;
+			reader >> trackCount >> albumCount;
+			for (t_uint32 i = 0; i < trackCount; ++i) {
+				metadb_index_hash hash = 0;
+				overlay_track t;
+				reader >> hash >> t.rec.title >> t.rec.album;
+				if (m_tracks.count(hash) == 0) set_overlay_locked(hash, t);
+			}
+			for (t_uint32 i = 0; i < albumCount; ++i) {
+				metadb_index_hash hash = 0;
+				overlay_album a;
+				reader >> hash >> a.album;
+				if (m_albums.count(hash) == 0) set_overlay_locked(hash, a);
+			}
+		}
+
+		void load_locked() {
+			abort_callback_dummy abort;
+			pfc::string8 native;
+			bool mapped = false;
+			try {
+				if (filesystem::g_get_native_path(m_path, native, abort)) mapped = m_view->map(native);
+			} catch (exception_io const&) {}
+
+			if (!mapped) {
 				file::ptr f;
 				try {
-					filesystem::g_open_write_new(f, m_path, abort);
+					filesystem::g_open_read(f, m_path, abort);
+				} catch (exception_io_not_found const&) {
+					FB2K_console_formatter() << "[latinize] DB not found: " << m_path;
+					return;
 				} catch (exception_io const&) {
-					// Fallback: attempt using native path rewrapped as file://
-					pfc::string8 native;
-					if (filesystem::g_get_native_path(m_path, native, abort)) {
-						pfc::string8 alt = "file://";
-						alt << native;
-						if (alt != m_path) {
-							filesystem::g_open_write_new(f, alt, abort);
-							FB2K_console_formatter() << "[latinize] DB save path fallback: " << alt;
-							m_path = alt;
-						}
-					} else {
-						throw;
-					}
+					FB2K_console_formatter() << "[latinize] Failed to open DB for read: " << m_path;
+					m_rewrite = true;
+					return;
+				}
+				try {
+					pfc::array_t<t_uint8> bytes;
+					bytes.set_size(pfc::downcast_guarded<t_size>(f->get_size_ex(abort)));
+					f->read_object(bytes.get_ptr(), bytes.get_size(), abort);
+					m_view->adopt(bytes);
+				} catch (exception_io const&) {
+					FB2K_console_formatter() << "[latinize] Failed to read DB: " << m_path;
+					m_rewrite = true;
+					return;
+				}
+			}
+
+			const t_uint8* data = m_view->data();
+			const size_t size = m_view->size();
+			t_uint32 version = 0;
+			try {
+				stream_reader_formatter_simple_ref<false> reader(data, size);
+				t_uint32 magic = 0;
+				reader >> magic >> version;
+				if (magic == file_magic && version > file_version) {
+					// Written by a newer build: keep it intact for that build.
+					reset_view_locked();
+					m_readOnly = true;
+					FB2K_console_formatter() << "[latinize] DB was written by a newer version and is left unchanged; clear the cache to start a new one: " << m_path;
+					return;
+				}
+				if (magic != file_magic || version < 1) {
+					// Appending after a header that is never accepted would lose every record.
+					reset_view_locked();
+					m_rewrite = true;
+					FB2K_console_formatter() << "[latinize] DB is not a latinize cache; it will be replaced: " << m_path;
+					return;
+				}
+				if (version < image_version) {
+					load_legacy_locked(reader);
+					m_baseBytes = size - reader.get_remaining();
+				} else {
+					m_baseBytes = m_image.bind(data, size);
+					if (m_baseBytes == 0) throw exception_io_data();
+					m_keyScheme = m_image.key_scheme();
+					// Keys made with an unknown scheme can never match.
+					if (m_keyScheme > key_xxh64) throw exception_io_data();
+				}
+			} catch (exception_io const&) {
+				reset_view_locked();
+				clear_overlay_locked();
+				m_rewrite = true;
+				FB2K_console_formatter() << "[latinize] Failed to read DB (corrupt?): " << m_path;
+				return;
+			}
+
+			if (version == 1) {
+				// v1 has no log; upgrade on the next save.
+				m_rewrite = true;
+				reset_view_locked();
+				return;
+			}
+
+			// Replay the append log. A torn tail (crash mid-append) keeps everything
+			// before it; the file is then rewritten so new records are not appended
+			// after garbage.
+			stream_reader_formatter_simple_ref<false> reader(data + m_baseBytes, size - m_baseBytes);
+			size_t tail = reader.get_remaining();
+			try {
+				while (tail > 0) {
+					if (!replay_locked(reader)) break;
+					// Only whole records count; a partial one is part of the tail.
+					tail = reader.get_remaining();
 				}
-				f->write_lendian_t<t_uint32>(0x544C4246, abort); // "FBLT"
-				f->write_lendian_t<t_uint32>(1, abort);
-				f->write_lendian_t<t_uint32>((t_uint32)m_tracks.size(), abort);
-				f->write_lendian_t<t_uint32>((t_uint32)m_albums.size(), abort);
-
-				for (auto const& kv : m_tracks) {
-					f->write_lendian_t<metadb_index_hash>(kv.first, abort);
-					f->write_string(kv.second.title, abort);
-					f->write_string(kv.second.album, abort);
+			} catch (exception_io const&) {}
+			m_logBytes = size - m_baseBytes - tail;
+			if (tail > 0) {
+				FB2K_console_formatter() << "[latinize] DB log has a damaged tail; it will be compacted: " << m_path;
+				m_rewrite = true;
+			}
+			if (version < image_version) {
+				// Everything now lives in the overlay; upgrade on the next save.
+				m_rewrite = true;
+				reset_view_locked();
+			} else if (version < file_version) {
+				// The image stays in use until the next save writes a v4 header.
+				m_rewrite = true;
+			}
+		}
+
+		// Appends m_pending to the existing file. Returns false if the file
+		// could not be opened for appending.
+		bool append_locked() {
+			abort_callback_dummy abort;
+			stream_writer_formatter_simple<false> writer;
+			for (auto const& op : m_pending) {
+				writer << op.type << op.hash;
+				switch (op.type) {
+				case op_set_track: writer << op.title << op.album; break;
+				case op_set_album:
+				case op_set_text: writer << op.album; break;
+				default: break;
 				}
-				for (auto const& kv : m_albums) {
-					f->write_lendian_t<metadb_index_hash>(kv.first, abort);
-					f->write_string(kv.second, abort);
+			}
+			try {
+				file::ptr f;
+				filesystem::g_open(f, m_path, filesystem::open_mode_write_existing, abort);
+				f->seek(f->get_size_ex(abort), abort);
+				f->write(writer.m_buffer.get_ptr(), writer.m_buffer.get_size(), abort);
+				f->commit(abort);
+			} catch (exception_io const&) {
+				return false;
+			}
+			m_logBytes += writer.m_buffer.get_size();
+			m_pending.clear();
+			return true;
+		}
+
+		// Merges image + overlay into a new v4 image in memory.
+		void build_image_locked(pfc::array_t<t_uint8>& out, t_uint32& trackCount, t_uint32& albumCount, t_uint32& textCount) const {
+			struct track_src { metadb_index_hash hash; const char* title; const char* album; };
+			struct album_src { metadb_index_hash hash; const char* album; };
+			std::vector<track_src> tracks;
+			std::vector<album_src> albums;
+			std::vector<album_src> texts;
+			tracks.reserve(m_image.track_count() + m_tracks.size());
+			albums.reserve(m_image.album_count() + m_albums.size());
+			texts.reserve(m_image.text_count() + m_texts.size());
+			for (t_uint32 i = 0; i < m_image.track_count(); ++i) {
+				const auto& t = m_image.track_at(i);
+				if (m_tracks.count(t.hash) > 0) continue;
+				tracks.push_back({ t.hash, m_image.string_at(t.titleOffset, t.titleLength), m_image.string_at(t.albumOffset, t.albumLength) });
+			}
+			for (auto const& kv : m_tracks) {
+				if (!kv.second.deleted) tracks.push_back({ kv.first, kv.second.rec.title.c_str(), kv.second.rec.album.c_str() });
+			}
+			for (t_uint32 i = 0; i < m_image.album_count(); ++i) {
+				const auto& a = m_image.album_at(i);
+				if (m_albums.count(a.hash) > 0) continue;
+				albums.push_back({ a.hash, m_image.string_at(a.offset, a.length) });
+			}
+			for (auto const& kv : m_albums) {
+				if (!kv.second.deleted) albums.push_back({ kv.first, kv.second.album.c_str() });
+			}
+			for (t_uint32 i = 0; i < m_image.text_count(); ++i) {
+				const auto& t = m_image.text_at(i);
+				if (m_texts.count(t.hash) > 0) continue;
+				texts.push_back({ t.hash, m_image.string_at(t.offset, t.length) });
+			}
+			for (auto const& kv : m_texts) {
+				if (!kv.second.deleted) texts.push_back({ kv.first, kv.second.album.c_str() });
+			}
+			const auto byHash = [](const album_src& a, const album_src& b) { return a.hash < b.hash; };
+			std::sort(tracks.begin(), tracks.end(), [](const track_src& a, const track_src& b) { return a.hash < b.hash; });
+			std::sort(albums.begin(), albums.end(), byHash);
+			std::sort(texts.begin(), texts.end(), byHash);
+
+			// Blob with identical strings stored once; offset 0 is the empty string.
+			std::string blob(1, '\0');
+			std::unordered_map<std::string, t_uint32> interned;
+			auto intern = [&](const char* s, t_uint32& offset, t_uint32& length) {
+				const size_t len = strlen(s);
+				length = (t_uint32)len;
+				if (len == 0) { offset = 0; return; }
+				auto ins = interned.emplace(std::string(s, len), (t_uint32)blob.size());
+				if (ins.second) blob.append(s, len + 1);
+				offset = ins.first->second;
+			};
+
+			std::vector<latin_image::track_entry> trackIndex(tracks.size());
+			for (size_t i = 0; i < tracks.size(); ++i) {
+				auto& e = trackIndex[i];
+				e.hash = tracks[i].hash;
+				intern(tracks[i].title, e.titleOffset, e.titleLength);
+				intern(tracks[i].album, e.albumOffset, e.albumLength);
+			}
+			auto string_index = [&](const std::vector<album_src>& src) {
+				std::vector<latin_image::album_entry> index(src.size());
+				for (size_t i = 0; i < src.size(); ++i) {
+					index[i].hash = src[i].hash;
+					intern(src[i].album, index[i].offset, index[i].length);
 				}
+				return index;
+			};
+			const std::vector<latin_image::album_entry> albumIndex = string_index(albums);
+			const std::vector<latin_image::album_entry> textIndex = string_index(texts);
+
+			trackCount = (t_uint32)trackIndex.size();
+			albumCount = (t_uint32)albumIndex.size();
+			textCount = (t_uint32)textIndex.size();
+			const t_uint32 header[8] = { file_magic, file_version, trackCount, albumCount, (t_uint32)blob.size(), m_keyScheme, textCount, 0 };
+			static_assert(sizeof(header) == latin_image::header_size, "FBLT v4 header");
+			const size_t trackBytes = trackIndex.size() * sizeof(latin_image::track_entry);
+			const size_t albumBytes = albumIndex.size() * sizeof(latin_image::album_entry);
+			const size_t textBytes = textIndex.size() * sizeof(latin_image::album_entry);
+			out.set_size(sizeof(header) + trackBytes + albumBytes + textBytes + blob.size());
+			t_uint8* p = out.get_ptr();
+			memcpy(p, header, sizeof(header)); p += sizeof(header);
+			if (trackBytes > 0) { memcpy(p, trackIndex.data(), trackBytes); p += trackBytes; }
+			if (albumBytes > 0) { memcpy(p, albumIndex.data(), albumBytes); p += albumBytes; }
+			if (textBytes > 0) { memcpy(p, textIndex.data(), textBytes); p += textBytes; }
+			memcpy(p, blob.data(), blob.size());
+		}
+
+		// Replaces `target` with `source` in one step; both are native paths.
+		static bool replace_file(const char* source, const char* target) {
+#ifdef _WIN32
+			return MoveFileExW(pfc::stringcvt::string_wide_from_utf8(source), pfc::stringcvt::string_wide_from_utf8(target),
+				MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != FALSE;
+#else
+			return ::rename(source, target) == 0;
+#endif
+		}
+
+		// Writes the whole file. Local files are written next to the DB and
+		// renamed over it, so a mapped old image is never truncated under its
+		// readers and a failed write leaves the old file intact.
+		void write_file_locked(const void* data, size_t size, abort_callback& abort) {
+			pfc::string8 native;
+			if (filesystem::g_get_native_path(m_path, native, abort)) {
+				pfc::string8 temp = m_path;
+				temp << ".tmp";
+				file::ptr f;
+				filesystem::g_open_write_new(f, temp, abort);
+				f->write(data, size, abort);
 				f->commit(abort);
+				f.release();
+				pfc::string8 nativeTemp = native;
+				nativeTemp << ".tmp";
+				if (!replace_file(nativeTemp, native)) throw exception_io_denied();
+				return;
+			}
+
+			file::ptr f;
+			try {
+				filesystem::g_open_write_new(f, m_path, abort);
+			} catch (exception_io const&) {
+				// Fallback: attempt using native path rewrapped as file://
+				if (filesystem::g_get_native_path(m_path, native, abort)) {
+					pfc::string8 alt = "file://";
+					alt << native;
+					if (alt != m_path) {
+						filesystem::g_open_write_new(f, alt, abort);
+						FB2K_console_formatter() << "[latinize] DB save path fallback: " << alt;
+						m_path = alt;
+					}
+				} else {
+					throw;
+				}
+			}
+			f->write(data, size, abort);
+			f->commit(abort);
+		}
+
+		// Swaps the in-memory image just written for a mapping of the file, so
+		// after a compaction the DB is paged from disk again, as after loading.
+		// The heap copy stays in use if the file cannot be mapped.
+		void remap_locked(abort_callback& abort) {
+			pfc::string8 native;
+			try {
+				if (!filesystem::g_get_native_path(m_path, native, abort)) return;
+			} catch (exception_io const&) {
+				return;
+			}
+			auto view = std::make_shared<latin_file_view>();
+			if (!view->map(native) || view->size() != m_view->size()) return;
+			latin_image image;
+			if (image.bind(view->data(), view->size()) != m_baseBytes) return;
+			m_view = std::move(view);
+			m_image = image;
+			m_stale = true;
+			publish_locked();
+		}
+
+		void save_locked() {
+			abort_callback_dummy abort;
+
+			// Build the new image first: it may reference strings in the mapped file.
+			pfc::array_t<t_uint8> bytes;
+			t_uint32 trackCount = 0, albumCount = 0, textCount = 0;
+			build_image_locked(bytes, trackCount, albumCount, textCount);
+
+			// From here on lookups go to the in-memory image. Snapshots published
+			// earlier keep the old view (and its mapping) alive on their own.
+			m_view = std::make_shared<latin_file_view>();
+			m_view->adopt(bytes);
+			m_baseBytes = m_image.bind(m_view->data(), m_view->size());
+			clear_overlay_locked();
+			m_pending.clear();
+			m_logBytes = 0;
+			m_stale = true;
+			publish_locked();
+
+			try {
+				pfc::string8 dir = m_path;
+				dir.truncate(dir.scan_filename());
+				if (dir.length() > 0) {
+					try {
+						filesystem::g_create_directory(dir, abort);
+					} catch (exception_io const&) {
+						// Directory may already exist or be provided by user; try to write anyway.
+					}
+				}
+
+				write_file_locked(m_view->data(), m_view->size(), abort);
+				m_rewrite = false;
+				remap_locked(abort);
 				FB2K_console_formatter() << "[latinize] DB saved: " << m_path
-					<< " (tracks=" << (t_uint32)m_tracks.size() << ", albums=" << (t_uint32)m_albums.size() << ")";
+					<< " (tracks=" << trackCount << ", albums=" << albumCount << ", texts=" << textCount << ")";
 			} catch (exception_io const&) {
-				// swallow write errors
+				// swallow write errors; the next save retries the full write
+				m_rewrite = true;
 				FB2K_console_formatter() << "[latinize] Failed to save DB: " << m_path;
 			}
 		}
@@ -327,19 +1817,123 @@ namespace {
 		std::mutex m_mutex;
 		pfc::string8 m_path;
 		bool m_loaded = false;
-		bool m_dirty = false;
-		std::unordered_map<metadb_index_hash, latin_record> m_tracks;
-		std::unordered_map<metadb_index_hash, pfc::string8> m_albums;
+		// Set when the file must be rewritten rather than appended to
+		// (legacy upgrade, damaged log, unreadable file, clear_all, failed save).
+		bool m_rewrite = false;
+		// Set when the file has a newer version; nothing is written to it
+		// until the cache is cleared.
+		bool m_readOnly = false;
+		t_uint32 m_keyScheme = key_md5;
+		size_t m_baseBytes = 0;
+		t_uint64 m_logBytes = 0;
+		std::shared_ptr<latin_file_view> m_view = std::make_shared<latin_file_view>();
+		latin_image m_image;
+		std::unordered_map<metadb_index_hash, overlay_track> m_tracks;
+		std::unordered_map<metadb_index_hash, overlay_album> m_albums;
+		std::unordered_map<metadb_index_hash, overlay_album> m_texts;
+		// Overlay as published to readers, and the changes not published yet.
+		std::vector<std::shared_ptr<const overlay_layer>> m_layers;
+		overlay_layer m_delta;
+		std::vector<log_op> m_pending;
+		// Live state differs from m_published.
+		bool m_stale = false;
+		t_uint64 m_generation = 0;
+		// Index storage: keys written since the last refresh, and whether the
+		// file has been considered for migration this session.
+		pfc::list_t<metadb_index_hash> m_refreshTracks;
+		pfc::list_t<metadb_index_hash> m_refreshAlbums;
+		bool m_migrated = false;
+		std::shared_ptr<const latin_snapshot> m_published;
+		// Negative tier, keyed by track hash.
+		std::unordered_map<metadb_index_hash, negative_entry> m_negative;
+		bool m_negativeDirty = false;
 	};
 
 	static latin_db g_db;
 
-	static latin_keyer& get_keyer() {
-		static latin_keyer g_keyer;
-		return g_keyer;
+	// Refreshes display of items changed by a run. With index storage the core
+	// refreshes by key instead, which also covers items sharing an album key.
+	static void refresh_changed(metadb_handle_list_cref changed) {
+		if (g_db.dispatch_index_refresh()) return;
+		static_api_ptr_t<metadb_io>()->dispatch_refresh(changed);
+	}
+
+	// Drops the shared-string entry for a source field, so that clearing an
+	// item really makes the next run ask again instead of reusing the text.
+	// Other items with the same text lose it too.
+	static bool forget_source_text(const file_info& info, const char* field) {
+		const char* text = info.meta_get(field, 0);
+		if (text == nullptr || *text == 0) return false;
+		return g_db.delete_text(hash_source_text(text));
+	}
+
+	// Item lists kept across sessions (background queue, resumable job): a
+	// magic, a version and a count, then (path, subsong) pairs. An empty list
+	// is stored as no file at all. A truncated file, as left by a crash during
+	// writing, yields the items read before the damage.
+	static constexpr t_uint32 item_list_version = 1;
+
+	static bool read_item_list(const char* path, t_uint32 magic, metadb_handle_list& out) {
+		out.remove_all();
+		abort_callback_dummy abort;
+		pfc::array_t<t_uint8> bytes;
+		try {
+			file::ptr f;
+			filesystem::g_open_read(f, path, abort);
+			bytes.set_size(pfc::downcast_guarded<t_size>(f->get_size_ex(abort)));
+			f->read_object(bytes.get_ptr(), bytes.get_size(), abort);
+		} catch (exception_io const&) {
+			return false;   // no saved list
+		}
+
+		try {
+			stream_reader_formatter_simple_ref<false> reader(bytes.get_ptr(), bytes.get_size());
+			t_uint32 fileMagic = 0, version = 0, count = 0;
+			reader >> fileMagic >> version >> count;
+			if (fileMagic != magic || version != item_list_version) return false;
+			auto api = metadb::get();
+			for (t_uint32 i = 0; i < count; ++i) {
+				pfc::string8 itemPath;
+				t_uint32 subsong = 0;
+				reader >> itemPath >> subsong;
+				metadb_handle_ptr handle;
+				api->handle_create(handle, make_playable_location(itemPath, subsong));
+				out.add_item(handle);
+			}
+		} catch (exception_io const&) {
+			FB2K_console_formatter() << "[latinize] Item list is damaged; keeping what could be read: " << path;
+		}
+		return true;
+	}
+
+	static void write_item_list(const char* path, t_uint32 magic, metadb_handle_list_cref items) {
+		abort_callback_dummy abort;
+		const t_size count = items.get_count();
+		if (count == 0) {
+			try {
+				if (filesystem::g_exists(path, abort)) filesystem::g_remove(path, abort);
+			} catch (exception_io const&) {}
+			return;
+		}
+
+		stream_writer_formatter_simple<false> writer;
+		writer << magic << item_list_version << pfc::downcast_guarded<t_uint32>(count);
+		for (t_size i = 0; i < count; ++i) {
+			writer << pfc::string8(items[i]->get_path()) << (t_uint32)items[i]->get_subsong_index();
+		}
+		try {
+			file::ptr f;
+			filesystem::g_open_write_new(f, path, abort);
+			f->write(writer.m_buffer.get_ptr(), writer.m_buffer.get_size(), abort);
+			f->commit(abort);
+		} catch (exception_io const&) {
+			FB2K_console_formatter() << "[latinize] Failed to save item list: " << path;
+		}
 	}
 
 	static void append_utf8(pfc::string8& out, uint32_t cp) {
+		// Surrogate halves are not characters of their own.
+		if (cp >= 0xD800 && cp <= 0xDFFF) cp = 0xFFFD;
 		char buf[5] = {};
 		size_t len = 0;
 		if (cp <= 0x7F) {
@@ -363,375 +1957,2696 @@ namespace {
 		out.add_string(buf, len);
 	}
 
-	static bool parse_json_string(const char*& p, pfc::string8& out) {
-		if (*p != '"') return false;
-		++p;
-		out.reset();
-		while (*p) {
-			char c = *p++;
-			if (c == '"') return true;
-			if (c == '\\') {
-				char e = *p++;
-				switch (e) {
-				case '"': out.add_char('"'); break;
-				case '\\': out.add_char('\\'); break;
-				case '/': out.add_char('/'); break;
-				case 'b': out.add_char('\b'); break;
-				case 'f': out.add_char('\f'); break;
-				case 'n': out.add_char('\n'); break;
-				case 'r': out.add_char('\r'); break;
-				case 't': out.add_char('\t'); break;
-				case 'u': {
-					uint32_t cp = 0;
-					for (int i = 0; i < 4; ++i) {
-						char h = *p++;
-						cp <<= 4;
-						if (h >= '0' && h <= '9') cp |= (h - '0');
-						else if (h >= 'a' && h <= 'f') cp |= (h - 'a' + 10);
-						else if (h >= 'A' && h <= 'F') cp |= (h - 'A' + 10);
-						else return false;
-					}
-					append_utf8(out, cp);
-					break;
-				}
-				default:
-					out.add_char(e);
-					break;
-				}
-			} else {
-				out.add_char(c);
-			}
+	// Length of the well-formed UTF-8 sequence at `s`, or 0 when the bytes
+	// there are not one (stray continuation bytes, overlong forms, encoded
+	// surrogates, code points above U+10FFFF, truncated sequences).
+	static size_t utf8_sequence_length(const unsigned char* s, const unsigned char* end) {
+		const unsigned char c = *s;
+		if (c < 0x80) return 1;
+		size_t n;
+		unsigned char lo = 0x80, hi = 0xBF;   // range of the second byte
+		if (c >= 0xC2 && c <= 0xDF) {
+			n = 2;
+		} else if (c >= 0xE0 && c <= 0xEF) {
+			n = 3;
+			if (c == 0xE0) lo = 0xA0;
+			else if (c == 0xED) hi = 0x9F;
+		} else if (c >= 0xF0 && c <= 0xF4) {
+			n = 4;
+			if (c == 0xF0) lo = 0x90;
+			else if (c == 0xF4) hi = 0x8F;
+		} else {
+			return 0;
 		}
-		return false;
+		if ((size_t)(end - s) < n || s[1] < lo || s[1] > hi) return 0;
+		for (size_t i = 2; i < n; ++i) {
+			if ((s[i] & 0xC0) != 0x80) return 0;
+		}
+		return n;
 	}
 
-	static bool json_find_string_value(const char* json, const char* key, pfc::string8& out) {
-		pfc::string8 pattern;
-		pattern << '"' << key << '"';
-		const char* search = json;
-		while (true) {
-			const char* p = strstr(search, pattern);
-			if (!p) return false;
-			p += pattern.length();
-			while (*p && *p != ':') ++p;
-			if (*p != ':') {
-				search = p;
+	// Length of the longest well-formed UTF-8 prefix of [text, text + length).
+	// ASCII, the bulk of API replies, is checked eight bytes at a time.
+	static size_t utf8_valid_prefix(const char* text, size_t length) {
+		const unsigned char* const begin = (const unsigned char*)text;
+		const unsigned char* const end = begin + length;
+		const unsigned char* p = begin;
+		while (p < end) {
+			const unsigned char c = *p;
+			// Three-byte sequences whose second byte may be any continuation
+			// byte (most of CJK) are checked inline.
+			if (c >= 0xE1 && c <= 0xEF && c != 0xED && end - p >= 3
+				&& (p[1] & 0xC0) == 0x80 && (p[2] & 0xC0) == 0x80) {
+				p += 3;
+				continue;
+			}
+			if (c >= 0x80) {
+				const size_t n = utf8_sequence_length(p, end);
+				if (n == 0) break;
+				p += n;
 				continue;
 			}
 			++p;
-			while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') ++p;
-			if (*p == '"') {
-				const char* pTry = p;
-				if (parse_json_string(pTry, out)) return true;
+			while (end - p >= 8) {
+				t_uint64 word;
+				memcpy(&word, p, 8);
+				if (word & 0x8080808080808080ull) break;
+				p += 8;
 			}
-			search = p + 1;
 		}
+		return p - begin;
 	}
 
-	static bool json_find_string_value_from(const char* start, const char* key, pfc::string8& out) {
-		if (!start) return false;
-		return json_find_string_value(start, key, out);
+	// Replaces every byte that does not belong to a well-formed UTF-8 sequence
+	// with U+FFFD. Leaves valid text untouched, without copying it.
+	static void repair_utf8(pfc::string8& text) {
+		const size_t length = text.length();
+		size_t valid = utf8_valid_prefix(text.get_ptr(), length);
+		if (valid == length) return;
+		const pfc::string8 source = text;
+		const char* p = source.get_ptr() + valid;
+		const char* const end = source.get_ptr() + length;
+		text.truncate(valid);
+		while (p < end) {
+			text.add_string_nc("\xEF\xBF\xBD", 3);
+			++p;
+			valid = utf8_valid_prefix(p, end - p);
+			text.add_string_nc(p, valid);
+			p += valid;
+		}
 	}
 
-	static bool extract_assistant_content(const char* json, pfc::string8& out) {
-		if (!json) return false;
-		const char* role = strstr(json, "\"role\":\"assistant\"");
-		if (!role) role = strstr(json, "\"role\": \"assistant\"");
-		if (!role) return false;
-		const char* p = role;
-		const char* key = "\"content\"";
-		while (true) {
-			const char* hit = strstr(p, key);
-			if (!hit) return false;
-			p = hit + strlen(key);
-			while (*p && *p != ':') ++p;
-			if (*p != ':') return false;
-			++p;
-			while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') ++p;
-			if (*p == '"') {
-				const char* pTry = p;
-				if (parse_json_string(pTry, out)) return true;
+	// First '"' or '\\' in [p, end), or `end`. Tests eight bytes per step for
+	// either byte value, so long unescaped runs go by at word speed. Bytes
+	// passed over are OR-ed into `seen`; its high bits tell whether the run
+	// held anything but ASCII.
+	static const char* find_json_string_stop(const char* p, const char* end, t_uint64& seen) {
+		const t_uint64 ones = 0x0101010101010101ull;
+		const t_uint64 highs = 0x8080808080808080ull;
+		while (end - p >= 8) {
+			t_uint64 word;
+			memcpy(&word, p, 8);
+			const t_uint64 quote = word ^ (ones * '"');
+			const t_uint64 backslash = word ^ (ones * '\\');
+			// Sets a high bit for each zero byte, i.e. each byte that matched.
+			if ((((quote - ones) & ~quote) | ((backslash - ones) & ~backslash)) & highs) break;
+			seen |= word;
+			p += 8;
+		}
+		while (p < end && *p != '"' && *p != '\\') seen |= (t_uint8)*p++;
+		return p;
+	}
+
+	// Token counts reported in a reply's "usage" object; -1 when absent.
+	struct latin_usage {
+		t_int64 promptTokens = -1;
+		t_int64 completionTokens = -1;
+		t_int64 totalTokens = -1;
+		// Prompt tokens served from the provider's prompt cache: DeepSeek's
+		// prompt_cache_hit_tokens or OpenAI's prompt_tokens_details.cached_tokens.
+		t_int64 cachedTokens = -1;
+	};
+
+	// Single-pass, resumable JSON reader for chat-completion replies.
+	// - Input may be fed in arbitrary pieces (a whole body, or the payload of
+	//   one SSE event split across reads); state survives between feed() calls.
+	// - Only a small container stack is kept. Strings are decoded only where
+	//   they matter: choices[0].message.content or choices[0].delta.content
+	//   (plain, or an array of {"text": ...} parts), choices[0].finish_reason,
+	//   usage.*_tokens (including the prompt cache hit count) and
+	//   error.{message,type,code}. Everything else is
+	//   skipped in bulk, so cost is linear in the input and independent of how
+	//   many keys precede the wanted ones or how they are spaced.
+	// - Decoded strings are well-formed UTF-8: \u surrogate pairs are combined,
+	//   lone surrogate halves and malformed raw bytes become U+FFFD.
+	class latin_json_reader {
+	public:
+		// Prepares for a new document; buffers keep their capacity.
+		void reset() {
+			m_state = s_value;
+			m_stack.clear();
+			m_hasContent = false;
+			m_content.reset();
+			m_finishReason.reset();
+			m_usage = latin_usage();
+			m_hasError = false;
+			m_errorMessage.reset();
+			m_errorType.reset();
+			m_errorCode.reset();
+		}
+
+		void feed(const char* data, size_t size) {
+			const char* p = data;
+			const char* const end = data + size;
+			while (m_state != s_error && p < end) p = step(p, end);
+		}
+
+		// Ends the input. False when the document was malformed or incomplete.
+		bool finish() {
+			if (m_state == s_literal && m_stack.empty()) end_literal();
+			return m_state == s_done;
+		}
+
+		bool has_content() const { return m_hasContent; }
+		const pfc::string8& content() const { return m_content; }
+		const pfc::string8& finish_reason() const { return m_finishReason; }
+		const latin_usage& usage() const { return m_usage; }
+		bool has_error() const { return m_hasError; }
+		// "message", falling back to "type"/"code" for terse error objects.
+		const pfc::string8& error_message() const { return m_errorMessage; }
+		const pfc::string8& error_type() const { return m_errorType; }
+		const pfc::string8& error_code() const { return m_errorCode; }
+
+	private:
+		// Where a value sits, as far as this reader cares.
+		enum node : t_uint8 {
+			n_other, n_root, n_choices, n_choice, n_message, n_content, n_part, n_part_text,
+			n_finish, n_usage, n_usage_prompt, n_usage_completion, n_usage_total,
+			n_usage_details, n_usage_cached,
+			n_error, n_error_message, n_error_type, n_error_code,
+		};
+		enum state : t_uint8 {
+			s_value, s_value_or_close, s_key, s_key_or_close, s_colon, s_after,
+			s_string, s_escape, s_unicode, s_literal, s_done, s_error,
+		};
+		struct frame {
+			node n;
+			bool array;
+			node pending;     // object: node of the value after the current key
+			t_uint32 index;   // array: index of the current element
+		};
+		enum { max_depth = 256, max_literal = 32 };
+
+		static node child_for_key(node parent, const char* key) {
+			switch (parent) {
+			case n_root:
+				if (!strcmp(key, "choices")) return n_choices;
+				if (!strcmp(key, "usage")) return n_usage;
+				if (!strcmp(key, "error")) return n_error;
+				break;
+			case n_choice:
+				if (!strcmp(key, "message") || !strcmp(key, "delta")) return n_message;
+				if (!strcmp(key, "finish_reason")) return n_finish;
+				break;
+			case n_message:
+				if (!strcmp(key, "content")) return n_content;
+				break;
+			case n_part:
+				if (!strcmp(key, "text")) return n_part_text;
+				break;
+			case n_usage:
+				if (!strcmp(key, "prompt_tokens")) return n_usage_prompt;
+				if (!strcmp(key, "completion_tokens")) return n_usage_completion;
+				if (!strcmp(key, "total_tokens")) return n_usage_total;
+				if (!strcmp(key, "prompt_cache_hit_tokens")) return n_usage_cached;
+				if (!strcmp(key, "prompt_tokens_details")) return n_usage_details;
+				break;
+			case n_usage_details:
+				if (!strcmp(key, "cached_tokens")) return n_usage_cached;
+				break;
+			case n_error:
+				if (!strcmp(key, "message")) return n_error_message;
+				if (!strcmp(key, "type")) return n_error_type;
+				if (!strcmp(key, "code")) return n_error_code;
+				break;
+			default:
+				break;
+			}
+			return n_other;
+		}
+
+		static node child_for_index(node parent, t_uint32 index) {
+			if (parent == n_choices) return index == 0 ? n_choice : n_other;
+			if (parent == n_content) return n_part;
+			return n_other;
+		}
+
+		static bool is_captured(node n) {
+			switch (n) {
+			case n_content: case n_part_text: case n_finish: case n_error:
+			case n_error_message: case n_error_type: case n_error_code:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		static bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+		node value_node() const {
+			if (m_stack.empty()) return n_root;
+			const frame& top = m_stack.back();
+			return top.array ? child_for_index(top.n, top.index) : top.pending;
+		}
+
+		const char* step(const char* p, const char* end) {
+			switch (m_state) {
+			case s_string: {
+				// Bulk path: everything up to the next quote or backslash is literal text.
+				const char* run = p;
+				p = find_json_string_stop(p, end, m_rawBytes);
+				if (p > run) {
+					end_surrogate();
+					if (m_capture) m_text.add_string_nc(run, p - run);
+				}
+				if (p == end) return p;
+				if (*p == '"') {
+					end_surrogate();
+					end_string();
+				} else {
+					m_state = s_escape;
+				}
+				return p + 1;
+			}
+			case s_escape: {
+				const char e = *p;
+				if (e == 'u') {
+					// All four digits at hand (the usual case): decode them here.
+					if (end - p > 4) {
+						t_uint32 cp = 0;
+						for (size_t i = 1; i <= 4; ++i) {
+							const int digit = hex_digit(p[i]);
+							if (digit < 0) return fail();
+							cp = (cp << 4) | (t_uint32)digit;
+						}
+						unicode_escape(cp);
+						m_state = s_string;
+						return p + 5;
+					}
+					m_state = s_unicode;
+					m_unicodeDigits = 0;
+					m_unicode = 0;
+					return p + 1;
+				}
+				end_surrogate();
+				if (m_capture) {
+					switch (e) {
+					case 'b': m_text.add_char('\b'); break;
+					case 'f': m_text.add_char('\f'); break;
+					case 'n': m_text.add_char('\n'); break;
+					case 'r': m_text.add_char('\r'); break;
+					case 't': m_text.add_char('\t'); break;
+					default: m_text.add_char(e); break;
+					}
+				}
+				m_state = s_string;
+				return p + 1;
+			}
+			case s_unicode: {
+				// Escape split across feed() calls: one digit at a time.
+				const int digit = hex_digit(*p);
+				if (digit < 0) return fail();
+				m_unicode = (m_unicode << 4) | (t_uint32)digit;
+				if (++m_unicodeDigits == 4) {
+					unicode_escape(m_unicode);
+					m_state = s_string;
+				}
+				return p + 1;
 			}
-			p = hit + 1;
+			case s_literal: {
+				const char c = *p;
+				if (is_space(c) || c == ',' || c == '}' || c == ']') {
+					end_literal();
+					return p;   // the terminator is handled in s_after
+				}
+				if (m_literalLength >= max_literal) return fail();
+				m_literal[m_literalLength++] = c;
+				return p + 1;
+			}
+			default:
+				break;
+			}
+
+			const char c = *p;
+			if (is_space(c)) return p + 1;
+			switch (m_state) {
+			case s_value_or_close:
+				if (c == ']') return close(true, p);
+				// fall through
+			case s_value:
+				return begin_value(c, p);
+			case s_key_or_close:
+				if (c == '}') return close(false, p);
+				// fall through
+			case s_key:
+				if (c != '"') return fail();
+				m_isKey = true;
+				m_capture = true;
+				m_highSurrogate = 0;
+				m_rawBytes = 0;
+				m_text.reset();
+				m_state = s_string;
+				return p + 1;
+			case s_colon:
+				if (c != ':') return fail();
+				m_state = s_value;
+				return p + 1;
+			case s_after:
+				if (c == ',') {
+					if (m_stack.empty()) return fail();
+					frame& top = m_stack.back();
+					if (top.array) {
+						++top.index;
+						m_state = s_value;
+					} else {
+						m_state = s_key;
+					}
+					return p + 1;
+				}
+				if (c == '}' || c == ']') return close(c == ']', p);
+				return fail();
+			case s_done:
+				return fail();   // trailing garbage after the document
+			default:
+				return fail();
+			}
+		}
+
+		const char* begin_value(char c, const char* p) {
+			const node n = value_node();
+			if (c == '{' || c == '[') {
+				if (m_stack.size() >= max_depth) return fail();
+				frame f;
+				f.n = n;
+				f.array = c == '[';
+				f.pending = n_other;
+				f.index = 0;
+				m_stack.push_back(f);
+				m_state = f.array ? s_value_or_close : s_key_or_close;
+				return p + 1;
+			}
+			if (c == '"') {
+				m_isKey = false;
+				m_target = n;
+				m_capture = is_captured(n);
+				m_highSurrogate = 0;
+				m_rawBytes = 0;
+				m_text.reset();
+				m_state = s_string;
+				return p + 1;
+			}
+			if (c == '}' || c == ']' || c == ',' || c == ':') return fail();
+			m_target = n;
+			m_literalLength = 0;
+			m_state = s_literal;
+			return p;
+		}
+
+		const char* close(bool array, const char* p) {
+			if (m_stack.empty() || m_stack.back().array != array) return fail();
+			m_stack.pop_back();
+			value_done();
+			return p + 1;
+		}
+
+		void value_done() {
+			m_state = m_stack.empty() ? s_done : s_after;
+		}
+
+		static int hex_digit(char h) {
+			if (h >= '0' && h <= '9') return h - '0';
+			if (h >= 'a' && h <= 'f') return h - 'a' + 10;
+			if (h >= 'A' && h <= 'F') return h - 'A' + 10;
+			return -1;
+		}
+
+		// Characters above U+FFFF arrive as a high and a low surrogate escape;
+		// the high half waits for its partner.
+		void unicode_escape(t_uint32 cp) {
+			if (cp >= 0xD800 && cp <= 0xDBFF) {
+				end_surrogate();
+				m_highSurrogate = cp;
+			} else if (cp >= 0xDC00 && cp <= 0xDFFF && m_highSurrogate) {
+				if (m_capture) append_utf8(m_text, 0x10000 + ((m_highSurrogate - 0xD800) << 10) + (cp - 0xDC00));
+				m_highSurrogate = 0;
+			} else {
+				end_surrogate();
+				if (m_capture) append_utf8(m_text, cp);
+			}
+		}
+
+		// A high surrogate escape not followed by a low one stands alone.
+		void end_surrogate() {
+			if (!m_highSurrogate) return;
+			if (m_capture) append_utf8(m_text, 0xFFFD);
+			m_highSurrogate = 0;
+		}
+
+		void end_string() {
+			if (m_isKey) {
+				m_stack.back().pending = child_for_key(m_stack.back().n, m_text.c_str());
+				m_state = s_colon;
+				return;
+			}
+			// Raw bytes are passed through as sent; malformed UTF-8 must not
+			// reach the console or the cache. Text decoded from escapes is
+			// always well formed, so only non-ASCII raw bytes need a look.
+			if (m_capture && (m_rawBytes & 0x8080808080808080ull)) repair_utf8(m_text);
+			switch (m_target) {
+			case n_content:
+			case n_part_text:
+				m_content << m_text;
+				m_hasContent = true;
+				break;
+			case n_finish: m_finishReason = m_text; break;
+			case n_error:   // "error": "text"
+			case n_error_message:
+				m_errorMessage = m_text;
+				m_hasError = true;
+				break;
+			case n_error_type: m_errorType = m_text; m_hasError = true; break;
+			case n_error_code: m_errorCode = m_text; m_hasError = true; break;
+			default: break;
+			}
+			value_done();
+		}
+
+		void end_literal() {
+			m_literal[m_literalLength] = 0;
+			const char* s = m_literal;
+			if (!strcmp(s, "true") || !strcmp(s, "false") || !strcmp(s, "null")) {
+				value_done();
+				return;
+			}
+			// Numbers: validated loosely, only integers are ever read.
+			bool negative = false;
+			size_t i = 0;
+			if (s[i] == '-') {
+				negative = true;
+				++i;
+			}
+			if (s[i] < '0' || s[i] > '9') {
+				fail();
+				return;
+			}
+			t_int64 v = 0;
+			for (; s[i] >= '0' && s[i] <= '9'; ++i) {
+				if (v < ((t_int64)1 << 58)) v = v * 10 + (s[i] - '0');
+			}
+			for (; s[i]; ++i) {
+				const char c = s[i];
+				if (!((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-')) {
+					fail();
+					return;
+				}
+			}
+			if (negative) v = -v;
+			switch (m_target) {
+			case n_usage_prompt: m_usage.promptTokens = v; break;
+			case n_usage_completion: m_usage.completionTokens = v; break;
+			case n_usage_total: m_usage.totalTokens = v; break;
+			case n_usage_cached: m_usage.cachedTokens = v; break;
+			case n_error_code:
+				m_errorCode.reset();
+				m_errorCode << s;
+				m_hasError = true;
+				break;
+			default: break;
+			}
+			value_done();
+		}
+
+		const char* fail() {
+			m_state = s_error;
+			return nullptr;
 		}
+
+		state m_state = s_value;
+		std::vector<frame> m_stack;
+		// Current string or literal.
+		bool m_isKey = false;
+		bool m_capture = false;
+		node m_target = n_other;
+		pfc::string8 m_text;
+		t_uint32 m_unicode = 0;
+		t_uint32 m_unicodeDigits = 0;
+		t_uint32 m_highSurrogate = 0;   // pending \uD800-\uDBFF escape, or 0
+		t_uint64 m_rawBytes = 0;        // unescaped bytes of the string, OR-ed
+		char m_literal[max_literal + 1] = {};
+		size_t m_literalLength = 0;
+		// Results.
+		bool m_hasContent = false;
+		pfc::string8 m_content;
+		pfc::string8 m_finishReason;
+		latin_usage m_usage;
+		bool m_hasError = false;
+		pfc::string8 m_errorMessage;
+		pfc::string8 m_errorType;
+		pfc::string8 m_errorCode;
+	};
+
+	// Parses a complete JSON document in one pass. False when it is not valid JSON.
+	static bool read_json(const char* json, size_t length, latin_json_reader& reader) {
+		reader.reset();
+		reader.feed(json, length);
+		return reader.finish();
 	}
 
-	static bool match_key_ci(const pfc::string8& line, const char* key, size_t& consumed) {
+	// Matches `key` at the start of [s, end), case-insensitively, skipping
+	// leading blanks and any ' ', '\t', '_' or '-' inside the text.
+	static bool match_key_ci(const char* s, const char* end, const char* key, size_t& consumed) {
 		if (!key) return false;
-		const char* s = line.c_str();
-		size_t i = 0;
-		while (s[i] == ' ' || s[i] == '\t') ++i;
-		size_t j = 0;
-		while (key[j] && s[i]) {
-			char c = s[i];
-			if (c == ' ' || c == '\t' || c == '_' || c == '-') { ++i; continue; }
-			char a = (char)tolower((unsigned char)c);
-			char b = (char)tolower((unsigned char)key[j]);
-			if (a != b) return false;
-			++i;
-			++j;
-		}
-		if (key[j] != 0) return false;
-		consumed = i;
+		const char* p = s;
+		while (p < end && (*p == ' ' || *p == '\t')) ++p;
+		while (*key && p < end) {
+			const char c = *p;
+			if (c == ' ' || c == '\t' || c == '_' || c == '-') { ++p; continue; }
+			if ((char)tolower((unsigned char)c) != (char)tolower((unsigned char)*key)) return false;
+			++p;
+			++key;
+		}
+		if (*key != 0) return false;
+		consumed = p - s;
 		return true;
 	}
 
-	static const char* skip_separators(const char* p) {
-		while (*p == ' ' || *p == '\t' || *p == ':' || *p == '-' ) ++p;
+	static const char* skip_separators(const char* p, const char* end) {
+		while (p < end && (*p == ' ' || *p == '\t' || *p == ':' || *p == '-')) ++p;
+		return p;
+	}
+
+	enum latin_field { field_none, field_title, field_album };
+
+	// Classifies one response line [s, end) as title_latin/album_latin and
+	// finds its value, trimmed of bytes <= 0x20, in place. With `index`
+	// non-null the line must start with an item number, as in batch responses
+	// ("3.title_latin: ..."); the 1-based number is returned there.
+	static latin_field classify_latin_line(const char* s, const char* end, size_t* index, latin_text& value) {
+		if (index) {
+			while (s < end && (*s == ' ' || *s == '\t')) ++s;
+			if (s == end || *s < '0' || *s > '9') return field_none;
+			size_t n = 0;
+			while (s < end && *s >= '0' && *s <= '9') {
+				n = n * 10 + (size_t)(*s - '0');
+				if (n > 100000) return field_none;
+				++s;
+			}
+			while (s < end && (*s == '.' || *s == ')' || *s == ':' || *s == ' ' || *s == '\t')) ++s;
+			*index = n;
+		}
+		size_t consumed = 0;
+		latin_field which;
+		if (match_key_ci(s, end, "titlelatin", consumed)) which = field_title;
+		else if (match_key_ci(s, end, "albumlatin", consumed)) which = field_album;
+		else return field_none;
+		const char* v = skip_separators(s + consumed, end);
+		while (v < end && (unsigned char)*v <= 0x20) ++v;
+		while (end > v && (unsigned char)end[-1] <= 0x20) --end;
+		value.ptr = v;
+		value.length = end - v;
+		return which;
+	}
+
+	static latin_field classify_latin_line(const char* s, const char* end, size_t* index, pfc::string8& value) {
+		latin_text span;
+		const latin_field which = classify_latin_line(s, end, index, span);
+		if (which != field_none) value.set_string(span.ptr, span.length);
+		return which;
+	}
+
+	// Next line of a response: skips line breaks, then returns the line's end
+	// (the next '\r', '\n' or the terminator) and sets `start`.
+	static const char* next_latin_line(const char*& p, const char*& start) {
+		while (*p == '\r' || *p == '\n') ++p;
+		start = p;
+		p += strcspn(p, "\r\n");
 		return p;
 	}
 
+	// Values are kept as spans into `text` until they are sanitized.
 	static bool parse_latin_lines(const pfc::string8& text, latin_record& out) {
 		const char* p = text.c_str();
-		pfc::string8 t, a;
+		latin_text t, a, value;
 		while (*p) {
-			while (*p == '\r' || *p == '\n') ++p;
-			const char* lineStart = p;
-			while (*p && *p != '\r' && *p != '\n') ++p;
-			pfc::string8 line;
-			line.add_string(lineStart, p - lineStart);
-			size_t consumed = 0;
-			if (match_key_ci(line, "titlelatin", consumed)) {
-				const char* q = line.c_str() + consumed;
-				q = skip_separators(q);
-				t = q;
-				trim_ascii(t);
-			} else if (match_key_ci(line, "albumlatin", consumed)) {
-				const char* q = line.c_str() + consumed;
-				q = skip_separators(q);
-				a = q;
-				trim_ascii(a);
-			}
-		}
-		out.title = sanitize_latin(t.c_str());
-		out.album = sanitize_latin(a.c_str());
+			const char* lineStart;
+			const char* lineEnd = next_latin_line(p, lineStart);
+			switch (classify_latin_line(lineStart, lineEnd, nullptr, value)) {
+			case field_title: t = value; break;
+			case field_album: a = value; break;
+			default: break;
+			}
+		}
+		out.title = sanitize_latin(t.ptr, t.length);
+		out.album = sanitize_latin(a.ptr, a.length);
 		return out.title.length() > 0 || out.album.length() > 0;
 	}
 
-	static void trim_ascii(pfc::string8& s) {
-		const char* p = s.c_str();
-		size_t start = 0;
-		size_t end = strlen(p);
-		while (start < end && (unsigned char)p[start] <= 0x20) ++start;
-		while (end > start && (unsigned char)p[end - 1] <= 0x20) --end;
-		if (start == 0 && end == strlen(p)) return;
-		pfc::string8 tmp;
-		tmp.add_string(p + start, end - start);
-		s = tmp;
+	// Batch variant: parses "N.title_latin:" / "N.album_latin:" records for
+	// items 1..out.size(). found[i] is set only for records that carried both
+	// keys and produced some output; everything else is left for the caller to
+	// retry as a single-item request. Returns the number of records found.
+	static size_t parse_latin_lines(const pfc::string8& text, std::vector<latin_record>& out, std::vector<char>& found) {
+		const size_t count = out.size();
+		std::vector<latin_text> titles(count), albums(count);
+		std::vector<char> seenTitle(count, 0), seenAlbum(count, 0);
+		const char* p = text.c_str();
+		latin_text value;
+		while (*p) {
+			const char* lineStart;
+			const char* lineEnd = next_latin_line(p, lineStart);
+			size_t index = 0;
+			const latin_field which = classify_latin_line(lineStart, lineEnd, &index, value);
+			if (which == field_none || index < 1 || index > count) continue;
+			if (which == field_title) {
+				titles[index - 1] = value;
+				seenTitle[index - 1] = 1;
+			} else {
+				albums[index - 1] = value;
+				seenAlbum[index - 1] = 1;
+			}
+		}
+
+		found.assign(count, 0);
+		size_t total = 0;
+		for (size_t i = 0; i < count; ++i) {
+			if (!seenTitle[i] || !seenAlbum[i]) continue;
+			out[i].title = sanitize_latin(titles[i].ptr, titles[i].length);
+			out[i].album = sanitize_latin(albums[i].ptr, albums[i].length);
+			if (out[i].title.length() == 0 && out[i].album.length() == 0) continue;
+			found[i] = 1;
+			++total;
+		}
+		return total;
+	}
+
+	// What sanitize_latin() makes of each byte: a lower-case letter or digit
+	// to keep, ' ' for a word separator, 0 to drop.
+	struct latin_sanitize_table {
+		char map[256];
+
+		latin_sanitize_table() {
+			for (int c = 0; c < 256; ++c) {
+				char m = 0;
+				if (c >= 'A' && c <= 'Z') m = (char)(c - 'A' + 'a');
+				else if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) m = (char)c;
+				else if (c == ' ' || c == '\t' || c == '-' || c == '_' || c == '.') m = ' ';
+				map[c] = m;
+			}
+		}
+	};
+
+	// Lower-case ASCII letters and digits, words separated by single spaces.
+	// Table-driven; output goes through a stack buffer in chunks, and as no
+	// space is ever written first or twice in a row, only one trailing space
+	// can need trimming.
+	static pfc::string8 sanitize_latin(const char* in, size_t length) {
+		static const latin_sanitize_table table;
+		pfc::string8 out;
+		char buffer[256];
+		size_t used = 0;
+		bool any = false;         // something written so far
+		bool prevSpace = false;   // the last byte written is a space
+		const unsigned char* const end = (const unsigned char*)in + length;
+		for (const unsigned char* p = (const unsigned char*)in; p < end; ++p) {
+			const char m = table.map[*p];
+			if (!m) continue;
+			if (m == ' ') {
+				if (prevSpace || !any) continue;
+				prevSpace = true;
+			} else {
+				prevSpace = false;
+				any = true;
+			}
+			buffer[used++] = m;
+			if (used == sizeof(buffer)) {
+				out.add_string_nc(buffer, used);
+				used = 0;
+			}
+		}
+		if (prevSpace) {
+			if (used > 0) --used;
+			else out.truncate(out.length() - 1);
+		}
+		out.add_string_nc(buffer, used);
+		return out;
 	}
 
 	static pfc::string8 sanitize_latin(const char* in) {
+		return sanitize_latin(in, strlen(in));
+	}
+
+	// A request prompt laid out for provider-side prompt caching (DeepSeek,
+	// OpenAI and others reuse the longest previously seen request prefix).
+	// `instructions` is the template text before the first placeholder line:
+	// it is the same for every request and goes into the system message, ahead
+	// of anything that varies. `payload` is the rest of the template with the
+	// item values filled in and is sent as the user message.
+	struct latin_prompt {
+		pfc::string8 instructions;
+		pfc::string8 payload;
+	};
+
+	// Splits a prompt template at the start of the first line that holds one of
+	// `tokens`. Without any placeholder the whole template is payload, as before.
+	static void split_prompt_template(const char* tmpl, std::initializer_list<const char*> tokens, latin_prompt& out) {
+		const char* first = nullptr;
+		for (const char* token : tokens) {
+			const char* hit = strstr(tmpl, token);
+			if (hit && (!first || hit < first)) first = hit;
+		}
+		out.instructions.reset();
+		if (!first) {
+			out.payload = tmpl;
+			return;
+		}
+		while (first > tmpl && first[-1] != '\n') --first;
+		size_t length = first - tmpl;
+		while (length > 0 && (tmpl[length - 1] == '\n' || tmpl[length - 1] == '\r')) --length;
+		out.instructions.set_string(tmpl, length);
+		out.payload = first;
+	}
+
+	// Appends `in` as the inside of a JSON string. Runs of plain bytes are
+	// copied in one go; control characters other than \n, \r and \t become spaces.
+	static void append_json_escaped(pfc::string8& out, const char* in, size_t length) {
+		const char* run = in;
+		const char* const end = in + length;
+		for (const char* p = in; p < end; ++p) {
+			const unsigned char b = (unsigned char)*p;
+			if (b >= 0x20 && b != '"' && b != '\\') continue;
+			out.add_string_nc(run, p - run);
+			switch (b) {
+			case '\\': out.add_string_nc("\\\\", 2); break;
+			case '"': out.add_string_nc("\\\"", 2); break;
+			case '\n': out.add_string_nc("\\n", 2); break;
+			case '\r': out.add_string_nc("\\r", 2); break;
+			case '\t': out.add_string_nc("\\t", 2); break;
+			default: out.add_char(' '); break;
+			}
+			run = p + 1;
+		}
+		out.add_string_nc(run, end - run);
+	}
+
+	static pfc::string8 json_escape(const char* in) {
 		pfc::string8 out;
-		bool prev_space = false;
-		for (const char* p = in; *p; ++p) {
-			const char c = *p;
-			if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')) {
-				out.add_char((char)tolower((unsigned char)c));
-				prev_space = false;
-			} else if (c >= '0' && c <= '9') {
-				out.add_char(c);
-				prev_space = false;
-			} else if (c == ' ' || c == '\t' || c == '-' || c == '_' || c == '.') {
-				if (!prev_space && out.length() > 0) {
-					out.add_char(' ');
-					prev_space = true;
+		append_json_escaped(out, in, strlen(in));
+		return out;
+	}
+
+	// Chat-completion request body compiled from one prompt setting.
+	// - The JSON around the prompt, the model name and the invariant
+	//   instructions are escaped once, at compile time.
+	// - The payload template is cut into literal segments, each followed by a
+	//   placeholder; literals are kept raw (for the Test page) and escaped.
+	// - build() is then one reservation and a run of copies, escaping only the
+	//   item values. The result is byte-for-byte what resolving the prompt with
+	//   replace_token() and escaping it as a whole would send, except that a
+	//   placeholder inside a value (a title reading "{album}") stays literal.
+	class latin_body_template {
+	public:
+		// `tokens` are the placeholders; build() takes one value per token, in this order.
+		void compile(const char* model, const char* prompt, std::initializer_list<const char*> tokens) {
+			latin_prompt parts;
+			split_prompt_template(prompt, tokens, parts);
+			m_instructions = parts.instructions;
+
+			m_head.reset();
+			m_head << "{\"model\":\"";
+			append_json_escaped(m_head, model, strlen(model));
+			m_head << "\",\"messages\":[{\"role\":\"system\",\"content\":\"You produce latinized ASCII-only names.";
+			if (parts.instructions.length() > 0) {
+				m_head << "\\n\\n";
+				append_json_escaped(m_head, parts.instructions.c_str(), parts.instructions.length());
+			}
+			m_head << "\"},{\"role\":\"user\",\"content\":\"";
+
+			m_segments.clear();
+			const char* p = parts.payload.c_str();
+			for (;;) {
+				const char* hit = nullptr;
+				size_t token = 0;
+				size_t tokenLength = 0;
+				size_t index = 0;
+				for (const char* t : tokens) {
+					const char* found = strstr(p, t);
+					if (found && (!hit || found < hit)) {
+						hit = found;
+						token = index;
+						tokenLength = strlen(t);
+					}
+					++index;
+				}
+				segment seg;
+				seg.raw.set_string(p, hit ? (size_t)(hit - p) : strlen(p));
+				append_json_escaped(seg.json, seg.raw.c_str(), seg.raw.length());
+				seg.value = hit ? (int)token : -1;
+				m_segments.push_back(std::move(seg));
+				if (!hit) break;
+				p = hit + tokenLength;
+			}
+		}
+
+		void build(const char* const* values, bool stream, pfc::string8& out) const {
+			static constexpr char tail[] = "\"}],\"stream\":false,\"temperature\":0.2}";
+			static constexpr char streamTail[] = "\"}],\"stream\":true,\"stream_options\":{\"include_usage\":true},\"temperature\":0.2}";
+			// Escaping at most doubles a value.
+			size_t bound = m_head.length() + sizeof(streamTail);
+			for (const segment& seg : m_segments) {
+				bound += seg.json.length();
+				if (seg.value >= 0) bound += 2 * strlen(values[seg.value]);
+			}
+			out.reset();
+			out.prealloc(bound);
+			out.add_string_nc(m_head.c_str(), m_head.length());
+			for (const segment& seg : m_segments) {
+				out.add_string_nc(seg.json.c_str(), seg.json.length());
+				if (seg.value >= 0) append_json_escaped(out, values[seg.value], strlen(values[seg.value]));
+			}
+			// Streamed replies only report usage when asked to, in a final chunk.
+			if (stream) out.add_string_nc(streamTail, sizeof(streamTail) - 1);
+			else out.add_string_nc(tail, sizeof(tail) - 1);
+		}
+
+		// The prompt as the model reads it, for the Test page.
+		void render(const char* const* values, pfc::string8& out) const {
+			out.reset();
+			if (m_instructions.length() > 0) out << m_instructions << "\n\n";
+			for (const segment& seg : m_segments) {
+				out << seg.raw;
+				if (seg.value >= 0) out << values[seg.value];
+			}
+		}
+
+	private:
+		struct segment {
+			pfc::string8 raw;
+			pfc::string8 json;
+			int value = -1;   // placeholder that follows, -1 after the last literal
+		};
+
+		pfc::string8 m_instructions;
+		pfc::string8 m_head;   // JSON up to the opening quote of the user message
+		std::vector<segment> m_segments;
+	};
+
+	struct latin_meters;
+	class latin_rate_limiter;
+
+	// Endpoint and compiled templates for the current API settings. Built on
+	// first use and again after the settings change (reload_request_settings());
+	// a run holds one reference throughout, so a change never reaches a run
+	// halfway. The offline benchmark substitutes its own endpoint, transport,
+	// limiter and meters, so its traffic never touches the session's.
+	struct latin_request_settings {
+		pfc::string8 url;
+		pfc::string8 authorization;   // "Bearer <key>", empty without a key
+		latin_body_template single;   // cfg_prompt: {title}, {album}
+		latin_body_template batch;    // cfg_batch_prompt: {items}
+		foo_latinize::http_transport* transport = nullptr;   // null: get_transport(url)
+		latin_rate_limiter* limiter = nullptr;               // null: g_limiter
+		latin_meters* meters = nullptr;                      // null: g_meters
+	};
+
+	static std::mutex g_settingsMutex;
+	static std::shared_ptr<const latin_request_settings> g_settings;
+
+	static std::shared_ptr<const latin_request_settings> get_request_settings() {
+		using namespace foo_latinize;
+		std::lock_guard<std::mutex> lock(g_settingsMutex);
+		if (!g_settings) {
+			auto settings = std::make_shared<latin_request_settings>();
+			settings->url = cfg_api_url.get();
+			const auto& key = cfg_api_key.get();
+			if (key.length() > 0) settings->authorization << "Bearer " << key;
+			settings->single.compile(cfg_api_model.get().c_str(), cfg_prompt.get().c_str(), { "{title}", "{album}" });
+			settings->batch.compile(cfg_api_model.get().c_str(), cfg_batch_prompt.get().c_str(), { "{items}" });
+			g_settings = std::move(settings);
+		}
+		return g_settings;
+	}
+
+	// Picks the text to scan for title_latin/album_latin lines out of an API response.
+	// A JSON reply must carry assistant content; anything that is not JSON is
+	// taken as the answer text itself.
+	static bool extract_response_text(const pfc::string8& response, pfc::string8& out, latin_usage* usage = nullptr) {
+		latin_json_reader reader;
+		if (!read_json(response.c_str(), response.length(), reader)) {
+			out = response;
+			return true;
+		}
+		if (usage) *usage = reader.usage();
+		if (!reader.has_content()) return false;
+		out = reader.content();
+		return true;
+	}
+
+	static bool parse_response_for_latin(const pfc::string8& response, latin_record& out) {
+		pfc::string8 text;
+		if (!extract_response_text(response, text)) return false;
+		return parse_latin_lines(text, out);
+	}
+
+	// Incremental reader for chat-completion SSE streams ("stream": true).
+	// Raw body bytes are fed as they arrive; each complete "data:" event is
+	// decoded and its delta text appended to content(). Every complete line of
+	// that text is passed to the line callback right away, so callers can act
+	// on title_latin/album_latin records before the response has finished.
+	class latin_sse_stream {
+	public:
+		typedef std::function<void(const char* line, size_t length)> line_callback;
+
+		explicit latin_sse_stream(line_callback onLine) : m_onLine(std::move(onLine)) {}
+
+		void feed(const char* data, size_t size) {
+			for (size_t i = 0; i < size; ++i) {
+				const char c = data[i];
+				if (c != '\n') {
+					m_event.add_char(c);
+					continue;
 				}
+				on_event_line();
+				m_event.reset();
+			}
+		}
+
+		// Flushes a final event or content line that lacked a terminator.
+		void finish() {
+			if (m_event.length() > 0) {
+				on_event_line();
+				m_event.reset();
+			}
+			emit_lines(true);
+		}
+
+		// True once at least one event carried a delta.
+		bool streamed() const { return m_events > 0; }
+		const pfc::string8& content() const { return m_content; }
+		const latin_usage& usage() const { return m_usage; }
+
+	private:
+		void on_event_line() {
+			const char* p = m_event.c_str();
+			size_t len = m_event.length();
+			if (len > 0 && p[len - 1] == '\r') --len;
+			// Comments (":"), "event:", "id:" and blank separators carry no text.
+			if (len < 5 || memcmp(p, "data:", 5) != 0) return;
+			p += 5;
+			len -= 5;
+			if (len > 0 && *p == ' ') {
+				++p;
+				--len;
+			}
+			if (len == 6 && memcmp(p, "[DONE]", 6) == 0) return;
+			++m_events;
+			if (!read_json(p, len, m_reader)) return;
+			// Usage arrives in the last chunk when the server reports it at all.
+			if (m_reader.usage().totalTokens >= 0) m_usage = m_reader.usage();
+			// Only delta chunks carry "content"; role/usage-only chunks are skipped.
+			if (!m_reader.has_content()) return;
+			m_content << m_reader.content();
+			emit_lines(false);
+		}
+
+		void emit_lines(bool final) {
+			const char* base = m_content.c_str();
+			const size_t end = m_content.length();
+			size_t pos = m_lineStart;
+			for (size_t i = pos; i < end; ++i) {
+				if (base[i] != '\n') continue;
+				if (m_onLine) m_onLine(base + pos, i - pos);
+				pos = i + 1;
+			}
+			if (final && pos < end) {
+				if (m_onLine) m_onLine(base + pos, end - pos);
+				pos = end;
+			}
+			m_lineStart = pos;
+		}
+
+		line_callback m_onLine;
+		latin_json_reader m_reader;
+		latin_usage m_usage;
+		pfc::string8 m_event;     // current, still incomplete SSE line
+		pfc::string8 m_content;   // assistant text assembled from deltas
+		size_t m_lineStart = 0;   // start of the first unreported content line
+		size_t m_events = 0;
+	};
+
+	static void append_body_snippet(pfc::string8& out, const pfc::string8& body, size_t maxLen = 2048) {
+		if (body.length() <= maxLen) {
+			out << "Body:\r\n" << body;
+			return;
+		}
+		pfc::string8 tmp;
+		tmp.add_string(body.c_str(), maxLen);
+		out << "Body (first " << (unsigned)maxLen << " bytes):\r\n" << tmp;
+	}
+
+	// What the server said about a request, beyond the body.
+	struct http_outcome {
+		int status = 0;            // HTTP status code, 0 when no reply was received
+		t_uint32 retryAfter = 0;   // Retry-After in seconds, 0 when absent or not numeric
+		latin_usage usage;         // token counts of a successful reply, when reported
+	};
+
+	// Retry-After is either delta-seconds or an HTTP-date; only the former is
+	// worth honouring precisely, dates fall back to our own backoff.
+	static t_uint32 parse_retry_after(const char* value) {
+		if (!value) return 0;
+		while (*value == ' ' || *value == '\t') ++value;
+		t_uint32 seconds = 0;
+		for (; *value >= '0' && *value <= '9'; ++value) {
+			seconds = seconds * 10 + (t_uint32)(*value - '0');
+			if (seconds > 3600) return 3600;
+		}
+		return seconds;
+	}
+
+	static bool is_throttle_status(int status) {
+		return status == 429 || status == 503;
+	}
+
+	// Token usage reported by the API for batch-run requests, summed over the
+	// session. Runs log the difference between two snapshots; when a
+	// background and a foreground run overlap, each sees both shares.
+	struct latin_token_stats {
+		t_int64 replies = 0;        // replies that reported usage
+		t_int64 cacheReplies = 0;   // ... and a prompt cache hit count
+		t_int64 prompt = 0;
+		t_int64 cached = 0;
+		t_int64 completion = 0;
+	};
+
+	class latin_token_counter {
+	public:
+		void add(const latin_usage& usage) {
+			if (usage.promptTokens < 0 && usage.completionTokens < 0) return;
+			++m_replies;
+			if (usage.promptTokens > 0) m_prompt += usage.promptTokens;
+			if (usage.completionTokens > 0) m_completion += usage.completionTokens;
+			if (usage.cachedTokens >= 0) {
+				++m_cacheReplies;
+				m_cached += usage.cachedTokens;
+			}
+		}
+
+		latin_token_stats snapshot() const {
+			latin_token_stats s;
+			s.replies = m_replies;
+			s.cacheReplies = m_cacheReplies;
+			s.prompt = m_prompt;
+			s.cached = m_cached;
+			s.completion = m_completion;
+			return s;
+		}
+
+		latin_token_stats since(const latin_token_stats& start) const {
+			latin_token_stats s = snapshot();
+			s.replies -= start.replies;
+			s.cacheReplies -= start.cacheReplies;
+			s.prompt -= start.prompt;
+			s.cached -= start.cached;
+			s.completion -= start.completion;
+			return s;
+		}
+
+	private:
+		std::atomic<t_int64> m_replies{ 0 };
+		std::atomic<t_int64> m_cacheReplies{ 0 };
+		std::atomic<t_int64> m_prompt{ 0 };
+		std::atomic<t_int64> m_cached{ 0 };
+		std::atomic<t_int64> m_completion{ 0 };
+	};
+
+	// Request latencies (send to last byte) in log-scale buckets: four per
+	// power of two of microseconds, so percentiles are within about 10%.
+	// Recording is one relaxed increment; readers take snapshots and diff them.
+	class latin_latency_histogram {
+	public:
+		enum { bucket_count = 4 * 40 };
+		typedef std::array<t_uint64, bucket_count> snapshot_t;
+
+		void record(std::chrono::steady_clock::duration elapsed) {
+			const t_uint64 us = (t_uint64)pfc::max_t<t_int64>(1, std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+			m_buckets[bucket_of(us)].fetch_add(1, std::memory_order_relaxed);
+		}
+
+		snapshot_t snapshot() const {
+			snapshot_t out;
+			for (size_t i = 0; i < bucket_count; ++i) out[i] = m_buckets[i].load(std::memory_order_relaxed);
+			return out;
+		}
+
+		static snapshot_t since(const snapshot_t& now, const snapshot_t& start) {
+			snapshot_t out;
+			for (size_t i = 0; i < bucket_count; ++i) out[i] = now[i] - start[i];
+			return out;
+		}
+
+		static t_uint64 count(const snapshot_t& s) {
+			t_uint64 n = 0;
+			for (t_uint64 v : s) n += v;
+			return n;
+		}
+
+		// Value below which a fraction `q` of the samples fall, in milliseconds.
+		static double percentile_ms(const snapshot_t& s, double q) {
+			const t_uint64 n = count(s);
+			if (n == 0) return 0;
+			const t_uint64 rank = pfc::min_t<t_uint64>(n, (t_uint64)(q * (double)n) + 1);
+			t_uint64 seen = 0;
+			for (size_t i = 0; i < bucket_count; ++i) {
+				seen += s[i];
+				if (seen >= rank) return (bucket_low(i) + bucket_low(i + 1)) / 2000.0;
+			}
+			return bucket_low(bucket_count) / 1000.0;
+		}
+
+	private:
+		static size_t bucket_of(t_uint64 us) {
+			unsigned exp = 0;
+			while ((us >> exp) > 1) ++exp;
+			const size_t sub = exp >= 2 ? (size_t)((us >> (exp - 2)) & 3) : (size_t)((us << (2 - exp)) & 3);
+			return pfc::min_t<size_t>(bucket_count - 1, exp * 4 + sub);
+		}
+
+		static double bucket_low(size_t i) {
+			return (double)((t_uint64)1 << (i / 4)) * (1.0 + (double)(i % 4) / 4);
+		}
+
+		std::atomic<t_uint64> m_buckets[bucket_count] = {};
+	};
+
+	// Where a run's time goes. Planning stages run on the calling thread,
+	// request stages on the workers, so stage sums are thread time and may
+	// exceed the run's wall time. Streamed answers are parsed while they
+	// arrive, which counts as network time.
+	enum latin_stage {
+		stage_hash,      // tag reads and cache keys
+		stage_lookup,    // cache lookups and deduplication while planning
+		stage_local,     // local engine
+		stage_wait,      // rate limiter, including throttle backoff
+		stage_network,   // send to last response byte
+		stage_parse,     // reading records out of replies
+		stage_store,     // cache writes and checkpoints
+		stage_count,
+	};
+	static const char* const stage_keys[stage_count] = { "hash", "lookup", "local", "wait", "network", "parse", "store" };
+	static const char* const stage_names[stage_count] = {
+		"Hashing", "Cache lookups", "Local engine", "Rate limit wait", "Network", "Parsing", "Cache writes",
+	};
+
+	// HTTP status slots: one per code from 100 to 599, and one for requests
+	// that got no status at all (network errors).
+	enum { status_first = 100, status_none = 500, status_slots = 501 };
+
+	// Stage times and status counts for the session. Like the counters above,
+	// recording is a relaxed increment and runs diff two snapshots.
+	class latin_telemetry {
+	public:
+		void add(latin_stage stage, std::chrono::steady_clock::duration elapsed, t_uint64 calls = 1) {
+			const t_int64 ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+			m_stageNs[stage].fetch_add((t_uint64)pfc::max_t<t_int64>(ns, 0), std::memory_order_relaxed);
+			m_stageCalls[stage].fetch_add(calls, std::memory_order_relaxed);
+		}
+
+		void record_status(int status) {
+			const size_t slot = status >= status_first && status < status_first + status_none ? (size_t)(status - status_first) : (size_t)status_none;
+			m_statuses[slot].fetch_add(1, std::memory_order_relaxed);
+		}
+
+		t_uint64 stage_ns(size_t stage) const { return m_stageNs[stage].load(std::memory_order_relaxed); }
+		t_uint64 stage_calls(size_t stage) const { return m_stageCalls[stage].load(std::memory_order_relaxed); }
+		t_uint64 status_count(size_t slot) const { return m_statuses[slot].load(std::memory_order_relaxed); }
+
+	private:
+		std::atomic<t_uint64> m_stageNs[stage_count] = {};
+		std::atomic<t_uint64> m_stageCalls[stage_count] = {};
+		std::atomic<t_uint64> m_statuses[status_slots] = {};
+	};
+
+	// Request errors printed to the console per run; the rest are only counted
+	// so a bad API key does not flood the console with one error per batch.
+	static constexpr int errors_logged_per_run = 5;
+
+	// Everything requests report into. g_meters is the session's, which the
+	// Latinize Stats page shows; the offline benchmark brings its own.
+	struct latin_meters {
+		latin_token_counter tokens;
+		latin_latency_histogram latency;
+		// Request and response body bytes; streamed replies count as received.
+		std::atomic<t_uint64> bytesSent{ 0 };
+		std::atomic<t_uint64> bytesReceived{ 0 };
+		latin_telemetry telemetry;
+		// Errors still printed in the current run (see errors_logged_per_run).
+		std::atomic<int> errorsToLog{ 0 };
+	};
+
+	static latin_meters g_meters;
+
+	static latin_meters& meters_of(const latin_request_settings& settings) {
+		return settings.meters ? *settings.meters : g_meters;
+	}
+
+	// Times the enclosing block into one stage.
+	class latin_stage_scope {
+	public:
+		explicit latin_stage_scope(latin_stage stage, latin_telemetry& sink = g_meters.telemetry)
+			: m_stage(stage), m_sink(sink), m_start(std::chrono::steady_clock::now()) {}
+		~latin_stage_scope() { m_sink.add(m_stage, std::chrono::steady_clock::now() - m_start); }
+
+	private:
+		latin_stage_scope(const latin_stage_scope&) = delete;
+		void operator=(const latin_stage_scope&) = delete;
+
+		const latin_stage m_stage;
+		latin_telemetry& m_sink;
+		const std::chrono::steady_clock::time_point m_start;
+	};
+
+	// What the Latinize Stats page shows, as counters that add up: per run,
+	// per session, and across sessions (cfg_stats_totals).
+	struct latin_stats {
+		// Filled by latinize_items().
+		t_uint64 runs = 0;
+		t_uint64 items = 0;
+		t_uint64 cached = 0;
+		t_uint64 shared = 0;
+		t_uint64 local = 0;
+		t_uint64 skipped = 0;
+		t_uint64 api = 0;            // items that needed the API
+		t_uint64 requestItems = 0;   // title/album pairs asked for after deduplication
+		t_uint64 failed = 0;
+		t_uint64 wallNs = 0;
+		// Differences of the session counters over the run.
+		t_uint64 bytesSent = 0;
+		t_uint64 bytesReceived = 0;
+		t_uint64 tokenReplies = 0;
+		t_uint64 promptTokens = 0;
+		t_uint64 cachedTokens = 0;
+		t_uint64 completionTokens = 0;
+		std::array<t_uint64, stage_count> stageNs = {};
+		std::array<t_uint64, stage_count> stageCalls = {};
+		std::array<t_uint64, status_slots> statuses = {};
+		latin_latency_histogram::snapshot_t latency = {};
+
+		void add(const latin_stats& other, bool subtract = false);
+	};
+
+	// Scalar counters by storage/export key.
+	static const struct {
+		const char* key;
+		t_uint64 latin_stats::* field;
+	} stats_fields[] = {
+		{ "runs", &latin_stats::runs },
+		{ "items", &latin_stats::items },
+		{ "cached", &latin_stats::cached },
+		{ "shared", &latin_stats::shared },
+		{ "local", &latin_stats::local },
+		{ "skipped", &latin_stats::skipped },
+		{ "api", &latin_stats::api },
+		{ "request_items", &latin_stats::requestItems },
+		{ "failed", &latin_stats::failed },
+		{ "wall_ns", &latin_stats::wallNs },
+		{ "bytes_sent", &latin_stats::bytesSent },
+		{ "bytes_received", &latin_stats::bytesReceived },
+		{ "token_replies", &latin_stats::tokenReplies },
+		{ "prompt_tokens", &latin_stats::promptTokens },
+		{ "cached_tokens", &latin_stats::cachedTokens },
+		{ "completion_tokens", &latin_stats::completionTokens },
+	};
+
+	void latin_stats::add(const latin_stats& other, bool subtract) {
+		auto apply = [subtract](t_uint64& to, t_uint64 from) { to = subtract ? to - from : to + from; };
+		for (const auto& f : stats_fields) apply(this->*f.field, other.*f.field);
+		for (size_t i = 0; i < stage_count; ++i) {
+			apply(stageNs[i], other.stageNs[i]);
+			apply(stageCalls[i], other.stageCalls[i]);
+		}
+		for (size_t i = 0; i < status_slots; ++i) apply(statuses[i], other.statuses[i]);
+		for (size_t i = 0; i < latency.size(); ++i) apply(latency[i], other.latency[i]);
+	}
+
+	// The session-wide counters; a run's share is the difference of two captures.
+	static void capture_stats(latin_stats& out) {
+		out = latin_stats();
+		for (size_t i = 0; i < stage_count; ++i) {
+			out.stageNs[i] = g_meters.telemetry.stage_ns(i);
+			out.stageCalls[i] = g_meters.telemetry.stage_calls(i);
+		}
+		for (size_t i = 0; i < status_slots; ++i) out.statuses[i] = g_meters.telemetry.status_count(i);
+		out.latency = g_meters.latency.snapshot();
+		out.bytesSent = g_meters.bytesSent;
+		out.bytesReceived = g_meters.bytesReceived;
+		const latin_token_stats tokens = g_meters.tokens.snapshot();
+		out.tokenReplies = (t_uint64)tokens.replies;
+		out.promptTokens = (t_uint64)tokens.prompt;
+		out.cachedTokens = (t_uint64)tokens.cached;
+		out.completionTokens = (t_uint64)tokens.completion;
+	}
+
+	// Storage form: one "key value" line per non-zero counter.
+	static void format_stats(const latin_stats& s, pfc::string8& out) {
+		out.reset();
+		for (const auto& f : stats_fields) {
+			if (s.*f.field) out << f.key << " " << s.*f.field << "\n";
+		}
+		for (size_t i = 0; i < stage_count; ++i) {
+			if (s.stageNs[i]) out << "stage." << stage_keys[i] << ".ns " << s.stageNs[i] << "\n";
+			if (s.stageCalls[i]) out << "stage." << stage_keys[i] << ".calls " << s.stageCalls[i] << "\n";
+		}
+		for (size_t i = 0; i < status_slots; ++i) {
+			if (!s.statuses[i]) continue;
+			out << "status.";
+			if (i == status_none) out << "none";
+			else out << (unsigned)(status_first + i);
+			out << " " << s.statuses[i] << "\n";
+		}
+		for (size_t i = 0; i < s.latency.size(); ++i) {
+			if (s.latency[i]) out << "latency." << (unsigned)i << " " << s.latency[i] << "\n";
+		}
+	}
+
+	// Reads format_stats() output; unknown keys are ignored.
+	static void parse_stats(const char* text, latin_stats& out) {
+		out = latin_stats();
+		while (*text) {
+			const char* end = text + strcspn(text, "\n");
+			const char* space = (const char*)memchr(text, ' ', end - text);
+			if (space) {
+				const pfc::string8 key(text, space - text);
+				const t_uint64 value = strtoull(pfc::string8(space + 1, end - space - 1).c_str(), nullptr, 10);
+				bool known = false;
+				for (const auto& f : stats_fields) {
+					if (!strcmp(key, f.key)) {
+						out.*f.field = value;
+						known = true;
+						break;
+					}
+				}
+				for (size_t i = 0; !known && i < stage_count; ++i) {
+					pfc::string8 prefix;
+					prefix << "stage." << stage_keys[i] << ".";
+					if (strncmp(key, prefix, prefix.length())) continue;
+					const char* what = key.c_str() + prefix.length();
+					if (!strcmp(what, "ns")) out.stageNs[i] = value;
+					else if (!strcmp(what, "calls")) out.stageCalls[i] = value;
+					known = true;
+				}
+				if (!known && !strncmp(key, "status.", 7)) {
+					const char* code = key.c_str() + 7;
+					if (!strcmp(code, "none")) {
+						out.statuses[status_none] = value;
+					} else {
+						const int n = atoi(code);
+						if (n >= status_first && n < status_first + status_none) out.statuses[n - status_first] = value;
+					}
+				} else if (!known && !strncmp(key, "latency.", 8)) {
+					const size_t bucket = (size_t)strtoul(key.c_str() + 8, nullptr, 10);
+					if (bucket < out.latency.size()) out.latency[bucket] = value;
+				}
+			}
+			text = *end ? end + 1 : end;
+		}
+	}
+
+	static std::mutex g_statsMutex;
+	static latin_stats g_lastRunStats;
+	static latin_stats g_sessionStats;
+	static latin_stats g_totalStats;
+	static bool g_totalStatsLoaded = false;
+
+	static void load_total_stats() {
+		if (g_totalStatsLoaded) return;
+		parse_stats(foo_latinize::cfg_stats_totals.get(), g_totalStats);
+		g_totalStatsLoaded = true;
+	}
+
+	// Adds a finished run to the session and all-time totals. The totals are
+	// written back to the config on the main thread.
+	static void record_run_stats(const latin_stats& run) {
+		pfc::string8 stored;
+		{
+			std::lock_guard<std::mutex> lock(g_statsMutex);
+			load_total_stats();
+			g_lastRunStats = run;
+			g_sessionStats.add(run);
+			g_totalStats.add(run);
+			format_stats(g_totalStats, stored);
+		}
+		fb2k::inMainThread([stored] { foo_latinize::cfg_stats_totals = stored; });
+	}
+
+	// Times a latinize_items() call and records it when the call ends,
+	// aborted or not; the caller fills in the item counters as it goes.
+	class latin_run_recorder {
+	public:
+		latin_run_recorder() : m_started(std::chrono::steady_clock::now()) {
+			capture_stats(m_start);
+		}
+
+		~latin_run_recorder() {
+			try {
+				latin_stats now;
+				current(now);
+				record_run_stats(now);
+			} catch (...) {}
+		}
+
+		// The run so far.
+		void current(latin_stats& out) const {
+			capture_stats(out);
+			out.add(m_start, true);
+			out.runs = 1;
+			out.items = run.items;
+			out.cached = run.cached;
+			out.shared = run.shared;
+			out.local = run.local;
+			out.skipped = run.skipped;
+			out.api = run.api;
+			out.requestItems = run.requestItems;
+			out.failed = run.failed;
+			out.wallNs = (t_uint64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_started).count();
+		}
+
+		latin_stats run;   // item counters of this run
+
+	private:
+		latin_stats m_start;
+		const std::chrono::steady_clock::time_point m_started;
+	};
+
+	// Core network request:
+	// - Posts a request body built by latin_body_template: the invariant
+	//   instructions first (system message), the per-item payload last, so
+	//   consecutive requests share a cacheable prefix.
+	// - Sends HTTP POST through the configured transport (see transport.h).
+	// - Returns the response body on a 2xx status.
+	// - Returns detailed error info for UI debugging.
+	// With `stream`, asks for SSE and feeds the body to it while it arrives;
+	// `response` then receives the assembled assistant text instead of JSON
+	// (unless the server ignored the request and stream->streamed() is false).
+	static bool post_completion(const latin_request_settings& settings, const pfc::string8& body, pfc::string8& response, abort_callback& abort, pfc::string8* outError, pfc::string8* outRaw, http_outcome* outcome = nullptr, latin_sse_stream* stream = nullptr) {
+		using namespace foo_latinize;
+
+		const pfc::string8& apiUrl = settings.url;
+		if (apiUrl.length() == 0) {
+			if (outError) *outError = "API URL is empty.";
+			return false;
+		}
+
+		latin_meters& meters = meters_of(settings);
+		try {
+			http_transport& transport = settings.transport ? *settings.transport : get_transport(apiUrl.c_str());
+			const auto started = std::chrono::steady_clock::now();
+			std::unique_ptr<http_response> reply = transport.post_json(apiUrl.c_str(), settings.authorization.c_str(), body, abort);
+			meters.bytesSent += body.length();
+
+			// Headers are in before the body, so streaming can be decided up front.
+			const pfc::string8& statusLine = reply->statusLine;
+			const pfc::string8& contentType = reply->contentType;
+			const pfc::string8& retryAfter = reply->retryAfter;
+			const int statusCode = reply->status;
+			const bool eventStream = stream != nullptr && statusCode >= 200 && statusCode < 300
+				&& strstr(contentType.c_str(), "text/event-stream") != nullptr;
+
+			response.reset();
+			{
+				t_uint8 buffer[4096];
+				while (true) {
+					const t_size got = reply->read(buffer, sizeof(buffer), abort);
+					if (got == 0) break;
+					meters.bytesReceived += got;
+					// Streamed bodies are consumed as they arrive instead of buffered.
+					if (eventStream) stream->feed((const char*)buffer, got);
+					else response.add_string((const char*)buffer, got);
+				}
+			}
+			const auto elapsed = std::chrono::steady_clock::now() - started;
+			meters.latency.record(elapsed);
+			meters.telemetry.add(stage_network, elapsed);
+			meters.telemetry.record_status(statusCode);
+			if (eventStream) {
+				stream->finish();
+				response = stream->content();
+			}
+			if (outRaw) {
+				pfc::string8 raw;
+				raw << "Request URL:\r\n" << apiUrl << " (" << transport.name() << ")\r\n\r\n";
+				raw << "Request Body:\r\n" << body << "\r\n\r\n";
+				raw << (eventStream ? "Streamed Content:\r\n" : "Response Body:\r\n") << response;
+				*outRaw = raw;
+			}
+
+			if (outcome) {
+				outcome->status = statusCode;
+				outcome->retryAfter = parse_retry_after(retryAfter.c_str());
+				if (statusCode >= 200 && statusCode < 300) {
+					if (eventStream) {
+						outcome->usage = stream->usage();
+					} else {
+						// A second pass over a reply of a few KB is noise next to the request.
+						latin_json_reader reader;
+						if (read_json(response.c_str(), response.length(), reader)) outcome->usage = reader.usage();
+					}
+				}
+			}
+			if (statusCode < 200 || statusCode >= 300) {
+				if (outError) {
+					pfc::string8 msg;
+					msg << "HTTP error. Status: " << (statusLine.length() ? statusLine : "unknown");
+					if (contentType.length() > 0) msg << "\r\nContent-Type: " << contentType;
+					latin_json_reader reader;
+					if (read_json(response.c_str(), response.length(), reader) && reader.has_error()) {
+						const pfc::string8& text = reader.error_message().length() > 0 ? reader.error_message()
+							: reader.error_type().length() > 0 ? reader.error_type() : reader.error_code();
+						msg << "\r\nAPI error: " << text;
+					}
+					if (response.length() > 0) {
+						msg << "\r\n";
+						append_body_snippet(msg, response);
+					}
+					*outError = msg;
+				}
+				return false;
+			}
+			return true;
+		} catch (exception_aborted const&) {
+			throw;
+		} catch (exception_io const& e) {
+			meters.telemetry.record_status(0);
+			if (outError) {
+				*outError = "Network/IO error: ";
+				*outError << e.what();
+			}
+			return false;
+		} catch (std::exception const&) {
+			if (outError) *outError = "Unexpected error.";
+			return false;
+		}
+	}
+
+	// Token-bucket limiter shared by every latinize worker.
+	// - Two buckets refill continuously from cfg_rate_rpm / cfg_rate_tpm (0 = no limit)
+	//   and hold about ten seconds' worth of budget, which smooths out bursts.
+	// - A 429/503 closes the gate for everyone: Retry-After when the server sent
+	//   one, otherwise exponential backoff with jitter. The effective rate is also
+	//   halved and then recovers slowly on success, so a misconfigured budget
+	//   converges on the provider's real ceiling instead of hitting it repeatedly.
+	class latin_rate_limiter {
+	public:
+		typedef std::chrono::steady_clock clock;
+
+		// Blocks until a request of roughly `tokens` tokens may be sent.
+		void acquire(double tokens, abort_callback& abort) {
+			for (;;) {
+				double waitSeconds;
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					const auto now = clock::now();
+					refill_locked(now);
+					if (now < m_blockedUntil) {
+						waitSeconds = std::chrono::duration<double>(m_blockedUntil - now).count();
+					} else {
+						const bool reqOk = m_rpm <= 0 || m_requests >= 1;
+						// A request larger than the whole bucket goes once the bucket is full.
+						const bool tokOk = m_tpm <= 0 || m_tokens >= pfc::min_t(tokens, capacity(m_tpm));
+						if (reqOk && tokOk) {
+							if (m_rpm > 0) m_requests -= 1;
+							if (m_tpm > 0) m_tokens -= tokens;
+							return;
+						}
+						waitSeconds = 0;
+						if (!reqOk) waitSeconds = pfc::max_t(waitSeconds, (1 - m_requests) * 60 / m_rpm);
+						if (!tokOk) waitSeconds = pfc::max_t(waitSeconds, (pfc::min_t(tokens, capacity(m_tpm)) - m_tokens) * 60 / m_tpm);
+					}
+				}
+				// Re-evaluate at least every second so budget changes and aborts are noticed.
+				abort.sleep(pfc::min_t(pfc::max_t(waitSeconds, 0.01), 1.0));
+			}
+		}
+
+		void on_throttled(int status, t_uint32 retryAfter) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			const auto now = clock::now();
+			if (m_streak < 6) ++m_streak;
+			m_scale = pfc::max_t(m_scale * 0.5, 0.125);
+
+			double delay;
+			if (retryAfter > 0) {
+				delay = retryAfter + jitter_locked(0, 1);
+			} else {
+				// 1s, 2s, 4s ... 60s, with "equal jitter" so workers do not retry in lockstep.
+				const double base = pfc::min_t(60.0, (double)(1u << (m_streak - 1)));
+				delay = base / 2 + jitter_locked(0, base / 2);
+			}
+			const auto until = now + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(delay));
+			if (until > m_blockedUntil) {
+				m_blockedUntil = until;
+				FB2K_console_formatter() << "[latinize] Rate limited (HTTP " << status << "), pausing requests for "
+					<< pfc::format_float(delay, 0, 1) << "s";
+			}
+			// Drain the buckets so the resumed stream starts slowly.
+			m_requests = 0;
+			m_tokens = 0;
+		}
+
+		void on_success() {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_streak = 0;
+			if (m_scale < 1) m_scale = pfc::min_t(1.0, m_scale * 1.05);
+		}
+
+	private:
+		static double capacity(double perMinute) {
+			return pfc::max_t(1.0, perMinute / 6);
+		}
+
+		void refill_locked(clock::time_point now) {
+			using namespace foo_latinize;
+			const double rpm = cfg_rate_rpm.get() * m_scale;
+			const double tpm = cfg_rate_tpm.get() * m_scale;
+			if (!m_started) {
+				m_started = true;
+				m_requests = capacity(rpm);
+				m_tokens = capacity(tpm);
+			} else {
+				const double minutes = std::chrono::duration<double>(now - m_last).count() / 60;
+				m_requests = pfc::min_t(capacity(rpm), m_requests + minutes * rpm);
+				m_tokens = pfc::min_t(capacity(tpm), m_tokens + minutes * tpm);
+			}
+			m_rpm = rpm;
+			m_tpm = tpm;
+			m_last = now;
+		}
+
+		double jitter_locked(double lo, double hi) {
+			return std::uniform_real_distribution<double>(lo, hi)(m_rng);
+		}
+
+		std::mutex m_mutex;
+		bool m_started = false;
+		clock::time_point m_last;
+		clock::time_point m_blockedUntil;
+		double m_rpm = 0;
+		double m_tpm = 0;
+		double m_requests = 0;
+		double m_tokens = 0;
+		double m_scale = 1;
+		unsigned m_streak = 0;
+		std::mt19937 m_rng{ std::random_device{}() };
+	};
+
+	static latin_rate_limiter g_limiter;
+
+	static latin_rate_limiter& limiter_of(const latin_request_settings& settings) {
+		return settings.limiter ? *settings.limiter : g_limiter;
+	}
+
+	// Throttled responses are retried in place (the worker keeps its job, so
+	// commits stay ordered) up to this many times before the job is failed.
+	static constexpr unsigned max_throttle_retries = 8;
+
+	// Rough token estimate for budgeting: ~3 bytes per token for mixed CJK/Latin
+	// text, plus the expected two short answer lines per item.
+	// The JSON framing of the body adds a constant hundred-odd bytes.
+	static double estimate_tokens(const pfc::string8& body, size_t items) {
+		return (double)body.length() / 3 + 24.0 * (double)items;
+	}
+
+	// post_completion() for batch runs: waits for the shared limiter and
+	// retries 429/503 responses after backing off.
+	static bool post_completion_limited(const latin_request_settings& settings, const pfc::string8& body, size_t items, pfc::string8& response, abort_callback& abort, latin_sse_stream* stream = nullptr) {
+		latin_rate_limiter& limiter = limiter_of(settings);
+		latin_meters& meters = meters_of(settings);
+		const double tokens = estimate_tokens(body, items);
+		for (unsigned attempt = 0;; ++attempt) {
+			{
+				latin_stage_scope wait(stage_wait, meters.telemetry);
+				limiter.acquire(tokens, abort);
+			}
+			http_outcome outcome;
+			pfc::string8 error;
+			if (post_completion(settings, body, response, abort, &error, nullptr, &outcome, stream)) {
+				limiter.on_success();
+				meters.tokens.add(outcome.usage);
+				return true;
+			}
+			if (!is_throttle_status(outcome.status) || attempt >= max_throttle_retries) {
+				if (error.length() > 0 && meters.errorsToLog.fetch_sub(1) > 0) {
+					FB2K_console_formatter() << "[latinize] Request failed: " << error;
+				}
+				return false;
+			}
+			limiter.on_throttled(outcome.status, outcome.retryAfter);
+		}
+	}
+
+	static void build_single_body(const latin_request_settings& settings, const char* title, const char* album, pfc::string8& body) {
+		const char* values[] = { title ? title : "", album ? album : "" };
+		settings.single.build(values, false, body);
+	}
+
+	// Single-item request: resolves cfg_prompt for one title/album pair and
+	// parses the two-line answer. Used directly by the Test page, so it
+	// bypasses the limiter and reports errors verbatim.
+	static bool request_latinized_ex(const char* title, const char* album, latin_record& out, abort_callback& abort, pfc::string8* outError, pfc::string8* outRaw) {
+		const auto settings = get_request_settings();
+		pfc::string8 body;
+		build_single_body(*settings, title, album, body);
+
+		pfc::string8 response;
+		const bool posted = post_completion(*settings, body, response, abort, outError, outRaw);
+		if (outRaw) {
+			const char* values[] = { title ? title : "", album ? album : "" };
+			pfc::string8 prompt;
+			settings->single.render(values, prompt);
+			pfc::string8 raw;
+			raw << "Resolved Prompt:\r\n" << prompt << "\r\n\r\n" << *outRaw;
+			*outRaw = raw;
+		}
+		if (!posted) return false;
+
+		if (parse_response_for_latin(response, out)) return true;
+		if (outError) {
+			pfc::string8 msg = "Parsed response but did not find latinized fields.";
+			if (response.length() > 0) {
+				msg << "\r\n";
+				append_body_snippet(msg, response);
+			}
+			*outError = msg;
+		}
+		return false;
+	}
+
+	// Rate-limited single-item request used by batch runs.
+	static bool request_latinized(const latin_request_settings& settings, const char* title, const char* album, latin_record& out, abort_callback& abort) {
+		pfc::string8 body, response;
+		build_single_body(settings, title, album, body);
+		if (!post_completion_limited(settings, body, 1, response, abort)) return false;
+		latin_stage_scope parse(stage_parse, meters_of(settings).telemetry);
+		return parse_response_for_latin(response, out);
+	}
+
+	// One unique title/album request planned by RunLatinize. `album` is left
+	// empty when another job (or the cache) already covers the album.
+	// Item of another track whose title text equals the job's title; it gets
+	// the job's answer under its own track key.
+	struct latin_title_follower {
+		metadb_handle_ptr handle;
+		metadb_index_hash trackHash = 0;
+		metadb_index_hash albumHash = 0;
+		bool albumPending = false;          // album asked for by an earlier job of the run
+	};
+
+	struct latin_job {
+		metadb_handle_list handles;         // selected items sharing this track hash
+		metadb_handle_list albumFollowers;  // items that only need this job's album
+		std::vector<latin_title_follower> titleFollowers;
+		pfc::string8 title;
+		pfc::string8 album;
+		pfc::string8 knownTitle;            // from the string cache when only the album is asked
+		metadb_index_hash trackHash = 0;
+		metadb_index_hash albumHash = 0;
+		metadb_index_hash titleKey = 0;     // string-cache key of `title`
+		bool albumPending = false;          // album asked for by an earlier job of the run
+		latin_record result;
+		bool ok = false;
+		bool stored = false;                // result already written by store_job_result()
+
+		t_size members() const { return handles.get_count() + albumFollowers.get_count() + titleFollowers.size(); }
+	};
+
+	// Title follower row held back until the job asking for its album commits.
+	struct latin_waiting_row {
+		metadb_index_hash trackHash = 0;
+		pfc::string8 title;
+	};
+	typedef std::unordered_map<metadb_index_hash, std::vector<latin_waiting_row>> latin_waiting_rows;
+
+	// Writes a finished job to the cache. Safe to call from worker threads.
+	// Returns false when the job produced nothing usable. A title follower
+	// whose album a later job asks for is moved to `waiting` rather than
+	// written without its album; without `waiting` all followers must be
+	// settled (see job_albums_settled()).
+	static bool store_job_result(latin_job& job, latin_waiting_rows* waiting = nullptr) {
+		latin_record& fresh = job.result;
+		if (job.ok && fresh.title.length() == 0) fresh.title = job.knownTitle;
+		if (!job.ok || (fresh.title.length() == 0 && fresh.album.length() == 0)) return false;
+		if (job.stored) return true;
+		latin_stage_scope store(stage_store);
+
+		// Prefer existing album cache to keep album naming consistent within the same album.
+		// Re-read here: the job owning this album commits before its other jobs
+		// (streamed records wait for it, see job_albums_settled()).
+		pfc::string8 cachedAlbum;
+		const bool haveAlbum = g_db.get_album(job.albumHash, cachedAlbum) && cachedAlbum.length() > 0;
+		if (haveAlbum) {
+			fresh.album = cachedAlbum;
+		}
+
+		g_db.set_track(job.trackHash, fresh);
+		if (!haveAlbum && fresh.album.length() > 0) g_db.set_album(job.albumHash, fresh.album);
+
+		// String cache: the first answer for a text wins, as for albums.
+		if (job.title.length() > 0 && fresh.title.length() > 0) g_db.add_text(job.titleKey, fresh.title);
+		if (job.album.length() > 0 && !haveAlbum && fresh.album.length() > 0) g_db.add_text(hash_source_text(job.album), fresh.album);
+		for (const auto& follower : job.titleFollowers) {
+			latin_record rec;
+			rec.title = fresh.title;
+			const bool haveFollowerAlbum = g_db.get_album(follower.albumHash, rec.album) && rec.album.length() > 0;
+			if (follower.albumPending && !haveFollowerAlbum && waiting != nullptr) {
+				latin_waiting_row row;
+				row.trackHash = follower.trackHash;
+				row.title = fresh.title;
+				(*waiting)[follower.albumHash].push_back(std::move(row));
+				continue;
+			}
+			g_db.set_track(follower.trackHash, rec);
+		}
+		job.stored = true;
+		return true;
+	}
+
+	// Writes the rows waiting for an album, once the job asking for it has
+	// committed. If that job failed they keep only the title.
+	static void release_waiting_rows(latin_waiting_rows& waiting, metadb_index_hash albumHash) {
+		auto it = waiting.find(albumHash);
+		if (it == waiting.end()) return;
+		pfc::string8 album;
+		g_db.get_album(albumHash, album);
+		for (auto& row : it->second) {
+			latin_record rec;
+			rec.title = std::move(row.title);
+			rec.album = album;
+			g_db.set_track(row.trackHash, rec);
+		}
+		waiting.erase(it);
+	}
+
+	// True when the albums the job's records take from the cache are there
+	// already. Albums asked for by an earlier job are written when that job
+	// commits; until then the job must wait for the ordered commit.
+	static bool job_albums_settled(const latin_job& job) {
+		auto settled = [](bool pending, metadb_index_hash hash) {
+			pfc::string8 album;
+			return !pending || (g_db.get_album(hash, album) && album.length() > 0);
+		};
+		if (!settled(job.albumPending, job.albumHash)) return false;
+		for (const auto& follower : job.titleFollowers) {
+			if (!settled(follower.albumPending, follower.albumHash)) return false;
+		}
+		return true;
+	}
+
+	// Batch items are embedded one field per line; keep tag values on one line.
+	static void append_batch_field(pfc::string8& out, size_t index, const char* key, const char* value) {
+		out << (unsigned)index << "." << key << ": ";
+		for (const char* p = value; *p; ++p) {
+			const char c = *p;
+			out.add_char((c == '\r' || c == '\n') ? ' ' : c);
+		}
+		out << "\n";
+	}
+
+	// Assembles numbered records from a streamed batch answer, one line at a
+	// time, and reports each job as soon as both of its lines have arrived.
+	class latin_batch_collector {
+	public:
+		latin_batch_collector(latin_job* jobs, size_t count, const std::function<void(latin_job&)>& onRecord)
+			: m_jobs(jobs), m_count(count), m_onRecord(onRecord), m_titles(count), m_albums(count), m_seen(count, 0) {}
+
+		void on_line(const char* line, size_t length) {
+			pfc::string8 value;
+			size_t index = 0;
+			const latin_field which = classify_latin_line(line, line + length, &index, value);
+			if (which == field_none || index < 1 || index > m_count) return;
+			const size_t i = index - 1;
+			if (m_jobs[i].ok) return;   // first complete record wins
+			if (which == field_title) {
+				m_titles[i] = value;
+				m_seen[i] |= 1;
+			} else {
+				m_albums[i] = value;
+				m_seen[i] |= 2;
+			}
+			if (m_seen[i] != 3) return;
+			latin_record rec;
+			rec.title = sanitize_latin(m_titles[i].c_str());
+			rec.album = sanitize_latin(m_albums[i].c_str());
+			if (rec.title.length() == 0 && rec.album.length() == 0) return;
+			m_jobs[i].result = rec;
+			m_jobs[i].ok = true;
+			if (m_onRecord) m_onRecord(m_jobs[i]);
+		}
+
+	private:
+		latin_job* const m_jobs;
+		const size_t m_count;
+		const std::function<void(latin_job&)>& m_onRecord;
+		std::vector<pfc::string8> m_titles;
+		std::vector<pfc::string8> m_albums;
+		std::vector<t_uint8> m_seen;   // bit 0: title line, bit 1: album line
+	};
+
+	// Multi-item request: one prompt carries `count` numbered title/album pairs.
+	// Jobs whose records the model omits or garbles are retried one by one, so
+	// on return every job has been attempted at least once.
+	// In streaming mode onRecord (if set) is called on this worker thread for
+	// each job as soon as its record has been received.
+	static void request_latinized_batch(const latin_request_settings& settings, latin_job* jobs, size_t count, abort_callback& abort, const std::function<void(latin_job&)>& onRecord = nullptr) {
+		using namespace foo_latinize;
+
+		if (count > 1) {
+			pfc::string8 items;
+			for (size_t i = 0; i < count; ++i) {
+				append_batch_field(items, i + 1, "title", jobs[i].title);
+				append_batch_field(items, i + 1, "album", jobs[i].album);
+			}
+			const char* values[] = { items.c_str() };
+			const bool stream = cfg_stream.get() != 0;
+			pfc::string8 body;
+			settings.batch.build(values, stream, body);
+
+			if (stream) {
+				latin_batch_collector collector(jobs, count, onRecord);
+				latin_sse_stream sse([&collector](const char* line, size_t length) { collector.on_line(line, length); });
+				pfc::string8 response, text;
+				// Records that arrived before a failure are kept.
+				if (post_completion_limited(settings, body, count, response, abort, &sse)
+					&& !sse.streamed() && extract_response_text(response, text)) {
+					// The server ignored "stream" and answered with a plain body.
+					const char* p = text.c_str();
+					while (*p) {
+						const char* end = p;
+						while (*end && *end != '\r' && *end != '\n') ++end;
+						collector.on_line(p, end - p);
+						p = end;
+						while (*p == '\r' || *p == '\n') ++p;
+					}
+				}
+			} else {
+				pfc::string8 response, text;
+				if (!post_completion_limited(settings, body, count, response, abort)) return;
+				latin_stage_scope parse(stage_parse, meters_of(settings).telemetry);
+				if (!extract_response_text(response, text)) return;
+
+				std::vector<latin_record> records(count);
+				std::vector<char> found;
+				parse_latin_lines(text, records, found);
+				for (size_t i = 0; i < count; ++i) {
+					if (!found[i]) continue;
+					jobs[i].result = records[i];
+					jobs[i].ok = true;
+				}
+			}
+		}
+
+		for (size_t i = 0; i < count; ++i) {
+			if (jobs[i].ok) continue;
+			abort.check();
+			jobs[i].ok = request_latinized(settings, jobs[i].title, jobs[i].album, jobs[i].result, abort);
+		}
+	}
+
+	// A numeric setting clamped to its valid range.
+	static size_t get_clamped(const cfg_uint& value, t_uint32 lo, t_uint32 hi) {
+		const t_uint32 n = (t_uint32)value.get();
+		if (n < lo) return lo;
+		if (n > hi) return hi;
+		return n;
+	}
+
+	static size_t get_concurrency() {
+		using namespace foo_latinize;
+		return get_clamped(cfg_concurrency, concurrency_min, concurrency_max);
+	}
+
+	static size_t get_auto_threads() {
+		using namespace foo_latinize;
+		return get_clamped(cfg_auto_threads, concurrency_min, concurrency_max);
+	}
+
+	static size_t get_batch_size() {
+		using namespace foo_latinize;
+		return get_clamped(cfg_batch_size, batch_size_min, batch_size_max);
+	}
+
+	// Local routes of the planning pass, in increasing order of effort; an
+	// item counts under the most involved route any of its fields took.
+	enum route { route_latin, route_kana, route_pinyin, route_count };
+
+	static route route_of(foo_latinize::text_script script) {
+		using namespace foo_latinize;
+		if (script == script_han) return route_pinyin;
+		if (script == script_kana) return route_kana;
+		return route_latin;
+	}
+
+	// Bounded worker pool for network jobs:
+	// - Up to `threads` workers claim indices [0, count) in order and call work().
+	// - done() is called on the calling thread, strictly in index order, so it
+	//   may touch non-thread-safe state (handle lists, progress reporting).
+	// - Abort stops workers from claiming more jobs; in-flight requests observe
+	//   the same abort_callback. exception_aborted is rethrown once all workers
+	//   have been joined.
+	// - tick() (optional) runs on the calling thread whenever it wakes up while
+	//   waiting, for progress that workers report between jobs.
+	static void run_pooled(size_t count, size_t threads, abort_callback& abort,
+		const std::function<void(size_t)>& work, const std::function<void(size_t)>& done,
+		const std::function<void()>& tick = nullptr) {
+		if (count == 0) return;
+		if (threads < 1) threads = 1;
+		if (threads > count) threads = count;
+
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::vector<char> finished(count, 0);
+		size_t next = 0;
+		size_t running = threads;
+		bool stop = false;
+
+		auto worker = [&] {
+			for (;;) {
+				size_t index = 0;
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					if (stop || next >= count || abort.is_aborting()) break;
+					index = next++;
+				}
+				bool aborted = false;
+				try {
+					work(index);
+				} catch (exception_aborted const&) {
+					aborted = true;
+				} catch (std::exception const& e) {
+					FB2K_console_formatter() << "[latinize] Worker error: " << e;
+				}
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					if (aborted) stop = true;
+					else finished[index] = 1;
+				}
+				cv.notify_one();
+				if (aborted) break;
+			}
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				--running;
+			}
+			cv.notify_one();
+		};
+
+		std::vector<std::thread> pool;
+		pool.reserve(threads);
+		// Workers reference locals of this frame; always join before leaving,
+		// including when done() throws.
+		auto joinAll = [&] {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stop = true;
+			}
+			for (auto& t : pool) t.join();
+			pool.clear();
+		};
+
+		try {
+			for (size_t i = 0; i < threads; ++i) pool.emplace_back(worker);
+
+			size_t committed = 0;
+			std::unique_lock<std::mutex> lock(mutex);
+			while (committed < count) {
+				if (finished[committed]) {
+					const size_t index = committed++;
+					lock.unlock();
+					done(index);
+					lock.lock();
+					continue;
+				}
+				if (running == 0) break;
+				if (abort.is_aborting()) stop = true;
+				cv.wait_for(lock, std::chrono::milliseconds(100));
+				if (tick) {
+					lock.unlock();
+					tick();
+					lock.lock();
+				}
+			}
+		} catch (...) {
+			joinAll();
+			throw;
+		}
+		joinAll();
+		abort.check();
+	}
+
+	// Flushes results to the cache file while a run is in progress, so a crash
+	// or an abort loses at most the last few seconds of paid answers. The
+	// database appends only the new records, so a checkpoint is cheap.
+	class latin_checkpointer {
+	public:
+		~latin_checkpointer() {
+			// Also reached when the run is aborted or throws.
+			try {
+				g_db.save_if_dirty(false);
+			} catch (...) {}
+		}
+
+		// `results`: items answered so far in this run.
+		void update(t_size results) {
+			const auto now = clock::now();
+			if (results <= m_saved) return;
+			if (results - m_saved < checkpoint_items && now - m_last < checkpoint_interval) return;
+			latin_stage_scope store(stage_store);
+			g_db.save_if_dirty(false);
+			m_saved = results;
+			m_last = now;
+		}
+
+	private:
+		typedef std::chrono::steady_clock clock;
+		static constexpr t_size checkpoint_items = 200;
+		static constexpr auto checkpoint_interval = std::chrono::seconds(10);
+
+		t_size m_saved = 0;
+		clock::time_point m_last = clock::now();
+	};
+
+	// The latinize pipeline for a set of items, on the calling (worker) thread:
+	// plan against the cache and the local engine, then send what is left to
+	// the API on up to `threads` workers. Items whose fields changed are added
+	// to `changed`; the caller refreshes them. `status` may be null. Results
+	// are checkpointed to the cache file as they arrive. Returns the number of
+	// items that could not be latinized.
+	// Latinize runs in flight (context menu, resume, background). Each run
+	// sends its requests under its own abort_callback_impl, which follows the
+	// caller's abort and is also fired at shutdown, so on_quit can stop every
+	// request before the transport is closed.
+	class latin_run_registry {
+	public:
+		// Returns false once shutdown has begun.
+		bool enter(abort_callback_impl& abort) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_closed) return false;
+			m_runs.insert(&abort);
+			return true;
+		}
+
+		void leave(abort_callback_impl& abort) {
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_runs.erase(&abort);
+			}
+			m_cv.notify_all();
+		}
+
+		// Aborts every run and refuses new ones; returns false if some run
+		// is still going after `timeout`.
+		bool close(std::chrono::milliseconds timeout) {
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_closed = true;
+			for (abort_callback_impl* abort : m_runs) abort->abort();
+			return m_cv.wait_for(lock, timeout, [this] { return m_runs.empty(); });
+		}
+
+	private:
+		std::mutex m_mutex;
+		std::condition_variable m_cv;
+		std::unordered_set<abort_callback_impl*> m_runs;
+		bool m_closed = false;
+	};
+
+	static latin_run_registry g_runs;
+
+	// Registers one run for its lifetime; get() is the abort the run uses.
+	class latin_run_scope {
+	public:
+		explicit latin_run_scope(abort_callback& caller) : m_caller(caller) {
+			if (!g_runs.enter(m_abort)) throw exception_aborted();
+		}
+		~latin_run_scope() { g_runs.leave(m_abort); }
+
+		abort_callback& get() { return m_abort; }
+
+		// Passes an abort of the caller on to the run.
+		void follow() {
+			if (m_caller.is_aborting()) m_abort.abort();
+		}
+
+	private:
+		latin_run_scope(const latin_run_scope&) = delete;
+		void operator=(const latin_run_scope&) = delete;
+
+		abort_callback& m_caller;
+		abort_callback_impl m_abort;
+	};
+
+	// Returns how many items were left without a result: a request failed, or
+	// the job was never committed (a worker error). An empty answer is a
+	// result, and so is a known failure skipped until its retry. An abort throws.
+	static t_size latinize_items(metadb_handle_list_cref items, size_t threads, threaded_process_status* status,
+		abort_callback& callerAbort, metadb_handle_list& changed) {
+		using namespace foo_latinize;
+		latin_run_scope run(callerAbort);
+		abort_callback& abort = run.get();
+		const t_size count = items.get_count();
+		auto set_progress = [status, count](t_size done) {
+			if (status) status->set_progress(done, count);
+		};
+		set_progress(0);
+
+		latin_run_recorder recorder;
+		recorder.run.items = count;
+		latin_checkpointer checkpoint;
+
+		// Planning pass: hashing and cache lookups are cheap, so do them
+		// here and only turn items that need a network round-trip into jobs.
+		// Items are deduplicated before anything is sent:
+		// - items sharing a track hash ride on one job;
+		// - only the first job of each album asks the model for the album
+		//   name, later ones get it from the album cache at commit time.
+		std::vector<latin_job> jobs;
+		std::unordered_map<metadb_index_hash, size_t> trackJobs;
+		std::unordered_map<metadb_index_hash, size_t> albumJobs;
+		std::unordered_map<metadb_index_hash, size_t> titleJobs;
+		t_size queued = 0;
+		t_size shared = 0;    // titles found in the string cache
+		t_size cached = 0;
+		t_size skipped = 0;   // failed on an earlier run, not yet due for a retry
+		t_size routed[route_count] = {};   // items latinized locally, by script route
+		const bool useLocal = cfg_local_engine.get() != 0;
+		// Stage times of the loop, added to the telemetry once at the end;
+		// whatever is not hashing or local engine is lookups and bookkeeping.
+		typedef std::chrono::steady_clock clock;
+		clock::duration hashTime{}, localTime{};
+		t_uint64 localCalls = 0;
+		const auto planStart = clock::now();
+		for (t_size i = 0; i < count; ++i) {
+			run.follow();
+			abort.check();
+
+			metadb_handle_ptr handle = items[i];
+			metadb_info_container::ptr infoContainer;
+			const auto hashStart = clock::now();
+			if (!handle->get_info_ref(infoContainer)) continue;
+
+			const file_info& info = infoContainer->info();
+			const auto trackHash = get_keyer().hash_track(info, handle->get_location());
+			const auto albumHash = get_keyer().hash_album(info, handle->get_location());
+			hashTime += clock::now() - hashStart;
+			const char* title = info.meta_get("TITLE", 0);
+			const char* album = info.meta_get("ALBUM", 0);
+			const bool hasTitle = title != nullptr && *title != 0;
+			const bool hasAlbum = album != nullptr && *album != 0;
+
+			pfc::string8 cachedAlbum;
+			bool haveAlbum = g_db.get_album(albumHash, cachedAlbum) && cachedAlbum.length() > 0;
+
+			latin_record rec;
+			const bool have = g_db.get_track(trackHash, rec);
+			if (have && !haveAlbum && rec.album.length() > 0) {
+				// Ensure album cache is populated from track record if needed
+				g_db.set_album(albumHash, rec.album);
+				cachedAlbum = rec.album;
+				haveAlbum = true;
+			}
+			if (!haveAlbum && hasAlbum && g_db.get_text(hash_source_text(album), cachedAlbum) && cachedAlbum.length() > 0) {
+				// Album text latinized before, as a title or under another album key.
+				g_db.set_album(albumHash, cachedAlbum);
+				haveAlbum = true;
+			}
+			if (have && rec.title.length() > 0 && haveAlbum) {
+				++cached;
+				continue;
+			}
+
+			auto sameTrack = trackJobs.find(trackHash);
+			if (sameTrack != trackJobs.end()) {
+				jobs[sameTrack->second].handles.add_item(handle);
+				++queued;
+				continue;
+			}
+
+			bool needAlbum = !haveAlbum && hasAlbum;
+			bool albumPending = false;
+			if (needAlbum) {
+				auto owner = albumJobs.find(albumHash);
+				if (owner != albumJobs.end()) {
+					needAlbum = false;
+					albumPending = true;
+					if (!hasTitle) {
+						// Nothing of its own to ask for; wait for the album owner.
+						jobs[owner->second].albumFollowers.add_item(handle);
+						++queued;
+						continue;
+					}
+				}
+			}
+
+			// Local engine first; only text it cannot read goes to the API.
+			// The title is done locally only when the album needs no request
+			// of its own, so the model still sees each pair it latinizes.
+			if (useLocal) {
+				// Timed until the end of the block, whichever way it is left.
+				struct lap {
+					clock::duration& total;
+					const clock::time_point start;
+					~lap() { total += clock::now() - start; }
+				} timer{ localTime, clock::now() };
+				++localCalls;
+				pfc::string8 romaji;
+				text_script script = script_ascii;
+				route itemRoute = route_latin;
+				bool albumLocal = false;
+				if (needAlbum && transliterate_local(album, romaji, &script)) {
+					const pfc::string8 latin = sanitize_latin(romaji);
+					if (latin.length() > 0) {
+						g_db.set_album(albumHash, latin);
+						cachedAlbum = latin;
+						haveAlbum = true;
+						needAlbum = false;
+						albumLocal = true;
+						itemRoute = route_of(script);
+					}
+				}
+				if (!needAlbum) {
+					latin_record local;
+					if (hasTitle && transliterate_local(title, romaji, &script)) local.title = sanitize_latin(romaji);
+					if (local.title.length() > 0 || (!hasTitle && albumLocal)) {
+						if (hasTitle) {
+							local.album = haveAlbum ? cachedAlbum : pfc::string8();
+							g_db.set_track(trackHash, local);
+							itemRoute = pfc::max_t(itemRoute, route_of(script));
+						}
+						changed.add_item(handle);
+						++routed[itemRoute];
+						continue;
+					}
+				}
+			}
+			if (!hasTitle && !needAlbum) continue;
+
+			// String cache: the same title text latinized for another track
+			// (or as an album name). The track record is written from it, and
+			// stays the override for this track from then on.
+			pfc::string8 knownTitle;
+			const metadb_index_hash titleKey = hasTitle ? hash_source_text(title) : 0;
+			if (hasTitle && g_db.get_text(titleKey, knownTitle) && knownTitle.length() > 0 && !needAlbum) {
+				latin_record rec;
+				rec.title = knownTitle;
+				rec.album = haveAlbum ? cachedAlbum : pfc::string8();
+				g_db.set_track(trackHash, rec);
+				changed.add_item(handle);
+				++shared;
+				continue;
 			}
-		}
-		trim_ascii(out);
-		return out;
-	}
 
-	static pfc::string8 replace_token(pfc::string8 src, const char* token, const char* value) {
-		pfc::string8 out;
-		const char* p = src.c_str();
-		const size_t tokenLen = strlen(token);
-		while (*p) {
-			const char* hit = strstr(p, token);
-			if (!hit) {
-				out.add_string(p);
-				break;
+			if (g_db.is_known_failure(trackHash)) {
+				++skipped;
+				continue;
 			}
-			out.add_string(p, hit - p);
-			out.add_string(value);
-			p = hit + tokenLen;
-		}
-		return out;
-	}
 
-	static pfc::string8 json_escape(const char* in) {
-		pfc::string8 out;
-		for (const char* p = in; *p; ++p) {
-			const unsigned char b = (unsigned char)*p;
-			switch (b) {
-			case '\\': out.add_string("\\\\"); break;
-			case '"': out.add_string("\\\""); break;
-			case '\n': out.add_string("\\n"); break;
-			case '\r': out.add_string("\\r"); break;
-			case '\t': out.add_string("\\t"); break;
-			default:
-				if (b < 0x20) {
-					// Control characters -> space
-					out.add_char(' ');
-				} else if (b < 0x80) {
-					out.add_char((char)b);
-				} else {
-					out.add_string((const char*)p, 1);
+			// Same title text already asked for in this run.
+			if (hasTitle && !needAlbum) {
+				auto sameTitle = titleJobs.find(titleKey);
+				if (sameTitle != titleJobs.end()) {
+					latin_title_follower follower;
+					follower.handle = handle;
+					follower.trackHash = trackHash;
+					follower.albumHash = albumHash;
+					follower.albumPending = albumPending;
+					jobs[sameTitle->second].titleFollowers.push_back(std::move(follower));
+					++queued;
+					continue;
 				}
-				break;
 			}
-		}
-		return out;
-	}
 
-	static bool parse_response_for_latin(const pfc::string8& response, latin_record& out) {
-		pfc::string8 assistantContent;
-		if (extract_assistant_content(response.c_str(), assistantContent)) {
-			return parse_latin_lines(assistantContent, out);
+			trackJobs[trackHash] = jobs.size();
+			if (needAlbum) albumJobs[albumHash] = jobs.size();
+
+			latin_job job;
+			job.handles.add_item(handle);
+			if (knownTitle.length() > 0) {
+				// Only the album is asked for.
+				job.knownTitle = knownTitle;
+			} else if (hasTitle) {
+				job.title = title;
+				job.titleKey = titleKey;
+				titleJobs[titleKey] = jobs.size();
+			}
+			job.album = needAlbum ? album : "";
+			job.albumPending = albumPending;
+			job.trackHash = trackHash;
+			job.albumHash = albumHash;
+			jobs.push_back(std::move(job));
+			++queued;
 		}
 
-		pfc::string8 content;
-		if (json_find_string_value(response.c_str(), "content", content)) {
-			return parse_latin_lines(content, out);
+		const auto planTime = clock::now() - planStart;
+		g_meters.telemetry.add(stage_hash, hashTime, count);
+		g_meters.telemetry.add(stage_local, localTime, localCalls);
+		g_meters.telemetry.add(stage_lookup, pfc::max_t(planTime - hashTime - localTime, clock::duration::zero()), count);
+		recorder.run.cached = cached;
+		recorder.run.shared = shared;
+		recorder.run.skipped = skipped;
+		for (t_size n : routed) recorder.run.local += n;
+		recorder.run.api = queued;
+		recorder.run.requestItems = jobs.size();
+
+		if (queued > 0) {
+			FB2K_console_formatter() << "[latinize] " << queued << " item(s) need latinizing, "
+				<< (t_size)jobs.size() << " unique request item(s) after deduplication.";
 		}
 
-		// If the response looks like JSON but we didn't parse content, do not fallback to raw text.
-		if (strstr(response.c_str(), "\"choices\"") != nullptr) return false;
+		// Items served from cache count as done.
+		t_size progress = count - queued;
+		t_size failed = 0;
+		t_size unresolved = 0;   // failed without an answer; worth resuming
+		set_progress(progress);
+		g_meters.errorsToLog = errors_logged_per_run;
+		const latin_token_stats tokensAtStart = g_meters.tokens.snapshot();
 
-		return parse_latin_lines(response, out);
-	}
+		// Consecutive jobs are grouped into batches; each batch is one pool work item.
+		const size_t batchSize = get_batch_size();
+		const size_t batchCount = (jobs.size() + batchSize - 1) / batchSize;
 
-	static int parse_status_code(const char* statusLine) {
-		if (!statusLine) return 0;
-		// Expected: "HTTP/1.1 200 OK"
-		const char* p = strchr(statusLine, ' ');
-		if (!p) return 0;
-		++p;
-		if (p[0] < '0' || p[0] > '9') return 0;
-		int code = 0;
-		for (int i = 0; i < 3 && p[i] >= '0' && p[i] <= '9'; ++i) {
-			code = code * 10 + (p[i] - '0');
-		}
-		return code;
-	}
+		// Streamed records are cached by the worker as they arrive; `streamed`
+		// counts their items so progress can move before the batch commits.
+		// Records arrive in any order, so a job whose album another job asks
+		// for is left to the ordered commit until that album is cached.
+		std::atomic<t_size> streamed(0);
+		t_size streamedDone = 0;
+		// Title follower rows waiting for an album from a later job.
+		latin_waiting_rows waiting;
+		const std::function<void(latin_job&)> onRecord = [&streamed](latin_job& job) {
+			if (job_albums_settled(job) && store_job_result(job)) streamed += job.members();
+		};
 
-	static void append_body_snippet(pfc::string8& out, const pfc::string8& body, size_t maxLen = 2048) {
-		if (body.length() <= maxLen) {
-			out << "Body:\r\n" << body;
-			return;
+		// One endpoint and set of templates for the whole run.
+		const auto settings = get_request_settings();
+		run_pooled(batchCount, threads, abort,
+			[&jobs, &abort, &onRecord, &settings, batchSize](size_t n) {
+				const size_t first = n * batchSize;
+				const size_t last = pfc::min_t<size_t>(first + batchSize, jobs.size());
+				request_latinized_batch(*settings, &jobs[first], last - first, abort, onRecord);
+			},
+			[&jobs, &abort, &set_progress, &checkpoint, &progress, &failed, &unresolved, &streamedDone, &waiting, &changed, batchSize](size_t n) {
+				const size_t first = n * batchSize;
+				const size_t last = pfc::min_t<size_t>(first + batchSize, jobs.size());
+				for (size_t j = first; j < last; ++j) {
+					latin_job& job = jobs[j];
+					const t_size members = job.members();
+					progress += members;
+					set_progress(progress);
+
+					if (job.stored) streamedDone += members;
+					const bool stored = store_job_result(job, &waiting);
+					// Commits are ordered, so every job that waits for this
+					// album has committed by now.
+					if (job.album.length() > 0) release_waiting_rows(waiting, job.albumHash);
+					if (!stored) {
+						failed += members;
+						if (!job.ok) unresolved += members;
+						// An aborted request says nothing about the item.
+						if (!abort.is_aborting()) {
+							const negative_reason reason = job.ok ? negative_empty : negative_failed;
+							g_db.note_failure(job.trackHash, reason);
+							for (const auto& follower : job.titleFollowers) g_db.note_failure(follower.trackHash, reason);
+						}
+						continue;
+					}
+
+					changed.add_items(job.handles);
+					if (job.result.album.length() > 0) changed.add_items(job.albumFollowers);
+					for (const auto& follower : job.titleFollowers) changed.add_item(follower.handle);
+				}
+				checkpoint.update(progress - failed);
+			},
+			[&run, &set_progress, &checkpoint, &progress, &failed, &streamed, &streamedDone, count] {
+				run.follow();
+				const t_size ahead = streamed.load() - streamedDone;
+				set_progress(pfc::min_t<t_size>(progress + ahead, count));
+				checkpoint.update(progress - failed + ahead);
+			});
+		{
+			latin_stage_scope store(stage_store);
+			// Albums whose job gave up without committing.
+			while (!waiting.empty()) release_waiting_rows(waiting, waiting.begin()->first);
+			g_db.save_if_dirty();
 		}
-		pfc::string8 tmp;
-		tmp.add_string(body.c_str(), maxLen);
-		out << "Body (first " << (unsigned)maxLen << " bytes):\r\n" << tmp;
+		recorder.run.failed = failed;
+		// Where the items went: only the API route costs requests. A fully
+		// cached set (common for background runs) is not worth a line.
+		if (cached < count) FB2K_console_formatter() << "[latinize] Routes: " << cached << " cached, " << shared << " shared, " << skipped << " skipped, "
+			<< routed[route_latin] << " latin, " << routed[route_kana] << " kana, "
+			<< routed[route_pinyin] << " pinyin (local), " << queued << " API in "
+			<< (t_size)jobs.size() << " request item(s).";
+		// What the API billed, and how much of the prompt its cache served.
+		const latin_token_stats tokens = g_meters.tokens.since(tokensAtStart);
+		if (tokens.replies > 0) {
+			pfc::string8 msg;
+			msg << "[latinize] Tokens: " << tokens.prompt << " prompt (";
+			if (tokens.cacheReplies > 0) {
+				const t_int64 percent = tokens.prompt > 0 ? tokens.cached * 100 / tokens.prompt : 0;
+				msg << tokens.cached << " cached, " << percent << "%";
+			} else {
+				msg << "prompt cache not reported";
+			}
+			msg << "), " << tokens.completion << " completion in " << tokens.replies << " request(s).";
+			FB2K_console_formatter() << msg;
+		}
+		// Where the time went; worker stages are summed over threads.
+		if (queued > 0) {
+			latin_stats run;
+			recorder.current(run);
+			pfc::string8 msg;
+			msg << "[latinize] Time: " << pfc::format_float((double)run.wallNs / 1e9, 0, 1) << " s;";
+			for (size_t i = 0; i < stage_count; ++i) {
+				msg << (i ? ", " : " ") << stage_keys[i] << " "
+					<< pfc::format_float((double)run.stageNs[i] / 1e6, 0, 0) << " ms";
+			}
+			msg << " (" << (t_uint64)threads << " thread(s), batches of " << (t_uint64)batchSize << ").";
+			FB2K_console_formatter() << msg;
+		}
+		if (failed > 0) {
+			if (cfg_negative_ttl.get() > 0) {
+				FB2K_console_formatter() << "[latinize] " << failed << " item(s) could not be latinized; they are skipped for a while (see the Latinize Cache page).";
+			} else {
+				FB2K_console_formatter() << "[latinize] " << failed << " item(s) could not be latinized; run again to retry them.";
+			}
+		}
+		// Jobs a worker gave up on are never committed, so progress stops short.
+		return unresolved + (count - progress);
 	}
 
-	// Core network request:
-	// - Builds the JSON payload for the LLM API.
-	// - Sends HTTP POST.
-	// - Parses response to extract latinized title/album.
-	// - Returns detailed error info for UI debugging.
-	static bool request_latinized_ex(const char* title, const char* album, latin_record& out, abort_callback& abort, pfc::string8* outError, pfc::string8* outRaw) {
-		using namespace foo_latinize;
+	// Per-handle memo for the display fields: keys are derived once per handle
+	// and the resolved strings are kept until the DB publishes a newer
+	// snapshot, so sorting or redrawing a large playlist costs one map lookup
+	// per row instead of titleformat + hash + DB lookup.
+	// Entries are dropped when the handle's tags change (metadb_io_callback).
+	// Each entry holds a reference to its handle so the address used as key
+	// cannot be reused by another handle while the entry exists.
+	class latin_memo {
+	public:
+		// Writes field `index` (0 = title, 1 = album) for the handle.
+		bool write_field(t_uint32 index, metadb_handle* handle, const file_info& info, const latin_snapshot& snap, titleformat_text_out* out) {
+			const t_uint32 scheme = g_keyScheme.load(std::memory_order_relaxed);
+			shard& sh = shard_of(handle);
+			std::unique_lock<std::mutex> lock(sh.mutex);
+			auto it = sh.entries.find(handle);
+			if (it == sh.entries.end() || it->second.scheme != scheme) {
+				// Derive keys without holding the shard.
+				lock.unlock();
+				entry e;
+				e.handle = handle;
+				e.scheme = scheme;
+				e.trackHash = get_keyer().hash_track(info, handle->get_location(), scheme);
+				e.albumHash = get_keyer().hash_album(info, handle->get_location(), scheme);
+				lock.lock();
+				if (sh.entries.size() >= shard_capacity) sh.entries.clear();
+				it = sh.entries.insert_or_assign(handle, std::move(e)).first;
+			}
+			entry& e = it->second;
+			// Older snapshots still held by other threads must not roll an entry back.
+			if (!e.resolved || e.generation < snap.generation()) resolve(e, snap);
+			const pfc::string8& value = (index == 0) ? e.title : e.album;
+			if (value.length() == 0) return false;
+			out->write(titleformat_inputtypes::meta, value.c_str(), value.length());
+			return true;
+		}
 
-		const auto& apiUrl = cfg_api_url.get();
-		if (apiUrl.length() == 0) {
-			if (outError) *outError = "API URL is empty.";
-			return false;
+		void invalidate(metadb_handle_list_cref items) {
+			for (t_size i = 0; i < items.get_count(); ++i) {
+				metadb_handle* handle = items[i].get_ptr();
+				shard& sh = shard_of(handle);
+				std::lock_guard<std::mutex> lock(sh.mutex);
+				sh.entries.erase(handle);
+			}
 		}
 
-		pfc::string8 prompt = cfg_prompt.get();
-		prompt = replace_token(prompt, "{title}", title ? title : "");
-		prompt = replace_token(prompt, "{album}", album ? album : "");
+		void clear() {
+			for (auto& sh : m_shards) {
+				std::lock_guard<std::mutex> lock(sh.mutex);
+				sh.entries.clear();
+			}
+		}
 
-		pfc::string8 body;
-		body << "{";
-		body << "\"model\":\"" << json_escape(cfg_api_model.get().c_str()) << "\",";
-		body << "\"messages\":[";
-		body << "{\"role\":\"system\",\"content\":\"You produce latinized ASCII-only names.\"},";
-		body << "{\"role\":\"user\",\"content\":\"" << json_escape(prompt.c_str()) << "\"}";
-		body << "],";
-		body << "\"stream\":false,";
-		body << "\"temperature\":0.2";
-		body << "}";
-
-		// HTTP request setup.
-		http_request::ptr baseReq = static_api_ptr_t<http_client>()->create_request("POST");
-		http_request_post_v2::ptr req;
-		req ^= baseReq;
-		req->add_header("Content-Type", "application/json");
-		const auto& key = cfg_api_key.get();
-		if (key.length() > 0) req->add_header("Authorization", PFC_string_formatter() << "Bearer " << key);
-		req->set_post_data(body.get_ptr(), body.length(), "application/json");
+	private:
+		static constexpr size_t shard_count = 16;
+		// Bounds memory (and pinned handles); a full shard starts over.
+		static constexpr size_t shard_capacity = 8192;
 
-		try {
-			file::ptr responseFile = req->run_ex(apiUrl.c_str(), abort);
+		struct entry {
+			metadb_handle_ptr handle;
+			t_uint32 scheme = key_md5;
+			metadb_index_hash trackHash = 0;
+			metadb_index_hash albumHash = 0;
+			bool resolved = false;
+			t_uint64 generation = 0;
+			// Field values as displayed: the album cache wins over the track's album.
+			pfc::string8 title;
+			pfc::string8 album;
+		};
 
-			pfc::string8 response;
-			{
-				t_uint8 buffer[4096];
-				while (true) {
-					const t_size got = responseFile->read(buffer, sizeof(buffer), abort);
-					if (got == 0) break;
-					response.add_string((const char*)buffer, got);
-				}
-			}
-			if (outRaw) {
-				pfc::string8 raw;
-				raw << "Request URL:\r\n" << apiUrl << "\r\n\r\n";
-				raw << "Resolved Prompt:\r\n" << prompt << "\r\n\r\n";
-				raw << "Request Body:\r\n" << body << "\r\n\r\n";
-				raw << "Response Body:\r\n" << response;
-				*outRaw = raw;
-			}
+		struct shard {
+			std::mutex mutex;
+			std::unordered_map<const metadb_handle*, entry> entries;
+		};
 
-			pfc::string8 statusLine;
-			pfc::string8 contentType;
-			http_reply::ptr reply;
-			reply ^= responseFile;
-			if (reply.is_valid()) {
-				reply->get_status(statusLine);
-				reply->get_http_header("content-type", contentType);
+		static void resolve(entry& e, const latin_snapshot& snap) {
+			e.generation = snap.generation();
+			e.resolved = true;
+			if (g_index.active()) {
+				// Index storage: the snapshot only carries the generation.
+				latin_record rec;
+				pfc::string8 cachedAlbum;
+				const bool haveTrack = g_index.get_track(e.trackHash, rec);
+				e.title = haveTrack ? rec.title : pfc::string8();
+				e.album = (g_index.get_album(e.albumHash, cachedAlbum) && cachedAlbum.length() > 0) ? cachedAlbum : (haveTrack ? rec.album : pfc::string8());
+				return;
 			}
-			const int statusCode = parse_status_code(statusLine.c_str());
-			if (statusCode < 200 || statusCode >= 300) {
-				if (outError) {
-					pfc::string8 msg;
-					msg << "HTTP error. Status: " << (statusLine.length() ? statusLine : "unknown");
-					if (contentType.length() > 0) msg << "\r\nContent-Type: " << contentType;
-					if (response.length() > 0) {
-						msg << "\r\n";
-						append_body_snippet(msg, response);
-					}
-					*outError = msg;
-				}
-				return false;
+			latin_text title, album, cached;
+			const bool haveTrack = snap.find_track(e.trackHash, title, album);
+			e.title.set_string(haveTrack ? title.ptr : "", haveTrack ? title.length : 0);
+			if (snap.find_album(e.albumHash, cached) && cached.length > 0) {
+				e.album.set_string(cached.ptr, cached.length);
+			} else {
+				e.album.set_string(haveTrack ? album.ptr : "", haveTrack ? album.length : 0);
 			}
+		}
 
-			if (parse_response_for_latin(response, out)) return true;
-			if (outError) {
-				pfc::string8 msg = "Parsed response but did not find latinized fields.";
-				if (response.length() > 0) {
-					msg << "\r\n";
-					append_body_snippet(msg, response);
-				}
-				*outError = msg;
-			}
-			return false;
-		} catch (exception_aborted const&) {
-			throw;
-		} catch (exception_io const&) {
-			if (outError) *outError = "Network/IO error.";
-			return false;
-		} catch (std::exception const&) {
-			if (outError) *outError = "Unexpected error.";
-			return false;
+		shard& shard_of(const metadb_handle* handle) {
+			// Handles are heap objects; drop the alignment bits.
+			return m_shards[((size_t)handle >> 4) % shard_count];
 		}
-	}
 
-	// Simple wrapper that hides raw/error outputs.
-	static bool request_latinized(const char* title, const char* album, latin_record& out, abort_callback& abort) {
-		return request_latinized_ex(title, album, out, abort, nullptr, nullptr);
-	}
+		shard m_shards[shard_count];
+	};
+
+	static latin_memo g_memo;
+
+	// Tag edits change the key strings; drop the affected entries. Refreshes
+	// from display hooks (including our own after a run) leave keys intact,
+	// and DB changes are already caught by the snapshot generation.
+	class latin_memo_io_callback : public metadb_io_callback {
+	public:
+		void on_changed_sorted(metadb_handle_list_cref items_sorted, bool bFromHook) override {
+			if (bFromHook) return;
+			g_memo.invalidate(items_sorted);
+		}
+	};
+	static service_factory_single_t<latin_memo_io_callback> g_latin_memo_io_callback;
 
 	// Exposes cached latinized values as title formatting fields:
 	// %foo_latin_title% and %foo_latin_album%
@@ -750,43 +4665,228 @@ namespace {
 		}
 		bool process_field_v2(t_uint32 index, metadb_handle* handle, metadb_v2::rec_t const& metarec, titleformat_text_out* out) override {
 			if (!metarec.info.is_valid()) return false;
-			g_db.ensure_loaded();
+			// No DB lock: only the first evaluation (before init) loads the DB.
+			auto snap = g_db.read();
+			if (!snap) {
+				g_db.ensure_loaded();
+				snap = g_db.read();
+				if (!snap) return false;
+			}
 
-			const auto& info = metarec.info->info();
-			const auto trackHash = get_keyer().hash_track(info, handle->get_location());
-			latin_record rec;
-			if (g_db.get_track(trackHash, rec)) {
-				if (index == 0 && rec.title.length() > 0) {
-					out->write(titleformat_inputtypes::meta, rec.title.c_str());
-					return true;
+			return g_memo.write_field(index, handle, metarec.info->info(), *snap, out);
+		}
+	};
+
+	static service_factory_single_t<metadb_display_field_provider_impl> g_display_field_factory;
+
+	// Background latinization of items added to or modified in the media
+	// library (opt-in). Handles are coalesced in a pending set and worked off
+	// by one low-priority thread: it waits for imports to settle, then feeds
+	// chunks through latinize_items() with its own in-flight limit, and can
+	// hold off while something is playing. The pending set is saved on quit
+	// and reloaded at startup, so a large import is not lost.
+	class latin_auto_queue {
+	public:
+		~latin_auto_queue() {
+			// stop() normally ran from on_quit already. Otherwise stop the
+			// worker here rather than leave it running into destroyed globals;
+			// the abort makes it return promptly.
+			if (!m_thread.joinable()) return;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stop = true;
+			}
+			m_abort.abort();
+			m_cv.notify_all();
+			m_thread.join();
+		}
+
+		void start() {
+			load();
+			m_thread = std::thread([this] { run(); });
+		}
+
+		void stop() {
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stop = true;
+			}
+			m_abort.abort();
+			m_cv.notify_all();
+			if (m_thread.joinable()) m_thread.join();
+			save();
+		}
+
+		void enqueue(metadb_handle_list_cref items) {
+			const t_size n = items.get_count();
+			if (n == 0) return;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				for (t_size i = 0; i < n; ++i) {
+					if (m_queued.insert(items[i].get_ptr()).second) m_pending.push_back(items[i]);
 				}
+				m_lastAdd = clock::now();
 			}
+			m_cv.notify_all();
+		}
 
-			if (index == 1) {
-				const auto albumHash = get_keyer().hash_album(info, handle->get_location());
-				pfc::string8 album;
-				if (g_db.get_album(albumHash, album) && album.length() > 0) {
-					out->write(titleformat_inputtypes::meta, album.c_str());
-					return true;
+		void remove(metadb_handle_list_cref items) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (t_size i = 0; i < items.get_count(); ++i) m_queued.erase(items[i].get_ptr());
+			// Entries no longer in m_queued are skipped when taken.
+		}
+
+		void set_playing(bool playing) {
+			m_playing = playing;
+			m_cv.notify_all();
+		}
+
+	private:
+		typedef std::chrono::steady_clock clock;
+
+		// Items added within this window are taken together.
+		static constexpr auto settle_time = std::chrono::seconds(3);
+		static constexpr size_t chunk_size = 200;
+		static constexpr t_uint32 queue_magic = 0x514C4246; // "FBLQ"
+
+		static pfc::string8 queue_path() {
+			return core_api::pathInProfile("foo_sample_latin_queue.dat");
+		}
+
+		bool runnable_locked() const {
+			using namespace foo_latinize;
+			if (m_stop) return true;
+			if (m_pending.empty() || !cfg_auto_latinize.get()) return false;
+			if (cfg_auto_pause_playback.get() && m_playing) return false;
+			return clock::now() - m_lastAdd >= settle_time;
+		}
+
+		void run() {
+#ifdef _WIN32
+			SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#endif
+			for (;;) {
+				metadb_handle_list chunk;
+				{
+					std::unique_lock<std::mutex> lock(m_mutex);
+					while (!runnable_locked()) m_cv.wait_for(lock, std::chrono::seconds(1));
+					if (m_stop) return;
+					while (chunk.get_count() < chunk_size && !m_pending.empty()) {
+						metadb_handle_ptr handle = std::move(m_pending.front());
+						m_pending.pop_front();
+						if (m_queued.erase(handle.get_ptr()) > 0) chunk.add_item(handle);
+					}
 				}
-				if (rec.album.length() > 0) {
-					out->write(titleformat_inputtypes::meta, rec.album.c_str());
-					return true;
+				if (chunk.get_count() == 0) continue;
+
+				metadb_handle_list changed;
+				try {
+					latinize_items(chunk, get_auto_threads(), nullptr, m_abort, changed);
+				} catch (exception_aborted const&) {
+					// Shutting down: put the chunk back so it is saved.
+					enqueue(chunk);
+					return;
+				} catch (std::exception const& e) {
+					FB2K_console_formatter() << "[latinize] Background run failed: " << e;
 				}
+				if (changed.get_count() > 0) {
+					fb2k::inMainThread([changed] { refresh_changed(changed); });
+				}
+			}
+		}
+
+		void load() {
+			metadb_handle_list items;
+			read_item_list(queue_path(), queue_magic, items);
+			if (items.get_count() > 0) {
+				FB2K_console_formatter() << "[latinize] Resuming background queue: " << items.get_count() << " item(s).";
+				enqueue(items);
 			}
+		}
 
-			return false;
+		void save() {
+			metadb_handle_list items;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				for (const auto& handle : m_pending) {
+					if (m_queued.count(handle.get_ptr())) items.add_item(handle);
+				}
+			}
+			write_item_list(queue_path(), queue_magic, items);
 		}
+
+		std::mutex m_mutex;
+		std::condition_variable m_cv;
+		std::deque<metadb_handle_ptr> m_pending;           // in arrival order
+		std::unordered_set<const metadb_handle*> m_queued; // members of m_pending still wanted
+		clock::time_point m_lastAdd;
+		bool m_stop = false;
+		std::atomic<bool> m_playing{ false };
+		abort_callback_impl m_abort;
+		std::thread m_thread;
 	};
 
-	static service_factory_single_t<metadb_display_field_provider_impl> g_display_field_factory;
+	static latin_auto_queue g_auto;
+
+	// Journal of the last context menu run: its item list is written when the
+	// run starts and removed once every item has been latinized. If the run is
+	// aborted, fails partway or foobar2000 exits or crashes, the file stays and
+	// "Resume latinize job" runs the list again; answers already checkpointed
+	// to the cache are served from it, so no paid request is repeated.
+	static constexpr t_uint32 job_magic = 0x4A4C4246; // "FBLJ"
+
+	static pfc::string8 job_path() {
+		return core_api::pathInProfile("foo_sample_latin_job.dat");
+	}
+
+	class latin_library_callback : public library_callback {
+	public:
+		void on_items_added(metadb_handle_list_cref items) override {
+			if (foo_latinize::cfg_auto_latinize.get()) g_auto.enqueue(items);
+		}
+		void on_items_removed(metadb_handle_list_cref items) override {
+			g_auto.remove(items);
+		}
+		void on_items_modified(metadb_handle_list_cref items) override {
+			// Tag edits change the keys; new keys start out uncached.
+			if (foo_latinize::cfg_auto_latinize.get()) g_auto.enqueue(items);
+		}
+	};
+	static library_callback_factory_t<latin_library_callback> g_latin_library_callback;
+
+	// Tracks whether anything is playing, for the pause-during-playback option.
+	class latin_play_callback : public play_callback_static {
+	public:
+		unsigned get_flags() override {
+			return flag_on_playback_new_track | flag_on_playback_stop | flag_on_playback_pause;
+		}
+		void on_playback_starting(play_control::t_track_command, bool) override {}
+		void on_playback_new_track(metadb_handle_ptr) override { g_auto.set_playing(true); }
+		void on_playback_stop(play_control::t_stop_reason) override { g_auto.set_playing(false); }
+		void on_playback_seek(double) override {}
+		void on_playback_pause(bool state) override { g_auto.set_playing(!state); }
+		void on_playback_edited(metadb_handle_ptr) override {}
+		void on_playback_dynamic_info(const file_info&) override {}
+		void on_playback_dynamic_info_track(const file_info&) override {}
+		void on_playback_time(double) override {}
+		void on_volume_change(float) override {}
+	};
+	static play_callback_static_factory_t<latin_play_callback> g_latin_play_callback;
 
 	// Load cache once config is read.
 	class init_stage_callback_impl : public init_stage_callback {
 	public:
 		void on_init_stage(t_uint32 stage) override {
 			if (stage == init_stages::after_config_read) {
+				// Registering here rather than before config read (as rating.cpp
+				// does) is needed to see the setting; it is still before
+				// playlists load, so the global refresh is cheap.
+				if (foo_latinize::cfg_index_storage.get()) g_index.start();
 				g_db.ensure_loaded();
+				g_auto.start();
+				if (foo_latinize::HasPendingLatinizeJob()) {
+					FB2K_console_formatter() << "[latinize] An unfinished latinize job can be resumed from Library > Latinize Sort > Resume latinize job.";
+				}
 			}
 		}
 	};
@@ -796,6 +4896,18 @@ namespace {
 	class initquit_impl : public initquit {
 	public:
 		void on_quit() override {
+			// Stop background work first; it saves what is still pending.
+			g_auto.stop();
+			// Then abort context menu runs still sending requests. Sessions are
+			// only closed once nothing uses them; a run that does not stop in
+			// time keeps them, and the process exit reclaims them.
+			if (g_runs.close(std::chrono::seconds(10))) {
+				foo_latinize::shutdown_transport();
+			} else {
+				FB2K_console_formatter() << "[latinize] A latinize run did not stop in time; leaving its connections open.";
+			}
+			// Release pinned handles while the metadb is still alive.
+			g_memo.clear();
 			g_db.save_if_dirty();
 		}
 	};
@@ -811,21 +4923,174 @@ namespace foo_latinize {
 	bool update_cache_entry(const cache_entry& entry) {
 		g_db.ensure_loaded();
 		const bool changed = g_db.update_entry(entry);
-		if (changed) g_db.save_if_dirty();
+		if (changed) {
+			g_db.save_if_dirty(false);
+			g_db.dispatch_index_refresh();
+		}
 		return changed;
 	}
 
 	bool delete_cache_entry(bool is_track, metadb_index_hash hash) {
 		g_db.ensure_loaded();
 		const bool changed = g_db.delete_entry(is_track, hash);
-		if (changed) g_db.save_if_dirty();
+		if (changed) {
+			g_db.save_if_dirty(false);
+			g_db.dispatch_index_refresh();
+		}
+		return changed;
+	}
+
+	bool delete_negative_entry(metadb_index_hash hash) {
+		g_db.ensure_loaded();
+		const bool changed = g_db.delete_negative(hash);
+		if (changed) g_db.save_if_dirty(false);
+		return changed;
+	}
+
+	bool delete_text_entry(metadb_index_hash hash) {
+		g_db.ensure_loaded();
+		const bool changed = g_db.delete_text(hash);
+		if (changed) g_db.save_if_dirty(false);
 		return changed;
 	}
 
+	void reload_cache() {
+		g_db.ensure_loaded();
+	}
+
+	void reload_request_settings() {
+		std::lock_guard<std::mutex> lock(g_settingsMutex);
+		g_settings.reset();
+	}
+
+	// Last run, session and all-time counters, in that order.
+	static void get_stats_views(latin_stats (&views)[3]) {
+		std::lock_guard<std::mutex> lock(g_statsMutex);
+		load_total_stats();
+		views[0] = g_lastRunStats;
+		views[1] = g_sessionStats;
+		views[2] = g_totalStats;
+	}
+
+	void get_stats_rows(pfc::list_t<stats_row>& out) {
+		latin_stats views[3];
+		get_stats_views(views);
+		out.remove_all();
+		auto row = [&out, &views](const char* name, const std::function<void(const latin_stats&, pfc::string8&)>& value) {
+			stats_row r;
+			r.name = name;
+			pfc::string8* cells[] = { &r.last_run, &r.session, &r.all_time };
+			for (size_t i = 0; i < 3; ++i) {
+				if (views[i].runs > 0) value(views[i], *cells[i]);
+			}
+			out.add_item(r);
+		};
+		auto count = [&row](const char* name, t_uint64 latin_stats::* field) {
+			row(name, [field](const latin_stats& s, pfc::string8& v) { v << s.*field; });
+		};
+		auto ratio = [](double value, double by, unsigned digits, pfc::string8& v) {
+			if (by > 0) v << pfc::format_float(value / by, 0, digits);
+		};
+
+		count("Runs", &latin_stats::runs);
+		count("Items", &latin_stats::items);
+		count("   from cache", &latin_stats::cached);
+		count("   shared titles", &latin_stats::shared);
+		count("   local engine", &latin_stats::local);
+		count("   skipped (failed earlier)", &latin_stats::skipped);
+		count("   needed the API", &latin_stats::api);
+		count("Request items (deduplicated)", &latin_stats::requestItems);
+		count("Failed items", &latin_stats::failed);
+		row("Wall time (s)", [](const latin_stats& s, pfc::string8& v) { v << pfc::format_float((double)s.wallNs / 1e9, 0, 2); });
+		row("Items per second", [ratio](const latin_stats& s, pfc::string8& v) { ratio((double)s.items, (double)s.wallNs / 1e9, 0, v); });
+		for (size_t i = 0; i < stage_count; ++i) {
+			pfc::string8 name;
+			name << stage_names[i] << " (ms)";
+			row(name, [i](const latin_stats& s, pfc::string8& v) { v << pfc::format_float((double)s.stageNs[i] / 1e6, 0, 1); });
+		}
+		row("Requests", [](const latin_stats& s, pfc::string8& v) { v << latin_latency_histogram::count(s.latency); });
+		row("Request items per request", [ratio](const latin_stats& s, pfc::string8& v) {
+			ratio((double)s.requestItems, (double)latin_latency_histogram::count(s.latency), 1, v);
+		});
+		static const double quantiles[] = { 0.5, 0.9, 0.99 };
+		static const char* const quantileNames[] = { "Latency p50 (ms)", "Latency p90 (ms)", "Latency p99 (ms)" };
+		for (size_t q = 0; q < PFC_TABSIZE(quantiles); ++q) {
+			row(quantileNames[q], [q](const latin_stats& s, pfc::string8& v) {
+				if (latin_latency_histogram::count(s.latency) > 0) v << pfc::format_float(latin_latency_histogram::percentile_ms(s.latency, quantiles[q]), 0, 1);
+			});
+		}
+		// One row per status any of the views has seen.
+		for (size_t slot = 0; slot < status_slots; ++slot) {
+			if (!views[0].statuses[slot] && !views[1].statuses[slot] && !views[2].statuses[slot]) continue;
+			pfc::string8 name;
+			if (slot == status_none) name = "No HTTP response";
+			else name << "HTTP " << (unsigned)(status_first + slot);
+			row(name, [slot](const latin_stats& s, pfc::string8& v) { v << s.statuses[slot]; });
+		}
+		count("Prompt tokens", &latin_stats::promptTokens);
+		count("   from prompt cache", &latin_stats::cachedTokens);
+		count("Completion tokens", &latin_stats::completionTokens);
+		count("Bytes sent", &latin_stats::bytesSent);
+		count("Bytes received", &latin_stats::bytesReceived);
+	}
+
+	void get_stats_json(pfc::string8& out) {
+		latin_stats views[3];
+		get_stats_views(views);
+		static const char* const viewKeys[] = { "last_run", "session", "all_time" };
+		auto number = [](double value) { return pfc::format_float(value, 0, 3); };
+
+		out.reset();
+		out << "{\n";
+		for (size_t v = 0; v < 3; ++v) {
+			const latin_stats& s = views[v];
+			out << "  \"" << viewKeys[v] << "\": {\n";
+			for (const auto& f : stats_fields) out << "    \"" << f.key << "\": " << s.*f.field << ",\n";
+			out << "    \"stages_ms\": {";
+			for (size_t i = 0; i < stage_count; ++i) {
+				out << (i ? ", " : " ") << "\"" << stage_keys[i] << "\": " << number((double)s.stageNs[i] / 1e6);
+			}
+			out << " },\n    \"stage_calls\": {";
+			for (size_t i = 0; i < stage_count; ++i) {
+				out << (i ? ", " : " ") << "\"" << stage_keys[i] << "\": " << s.stageCalls[i];
+			}
+			out << " },\n    \"http_status\": {";
+			bool first = true;
+			for (size_t slot = 0; slot < status_slots; ++slot) {
+				if (!s.statuses[slot]) continue;
+				out << (first ? " " : ", ") << "\"";
+				if (slot == status_none) out << "none";
+				else out << (unsigned)(status_first + slot);
+				out << "\": " << s.statuses[slot];
+				first = false;
+			}
+			const t_uint64 requests = latin_latency_histogram::count(s.latency);
+			out << " },\n    \"requests\": " << requests << ",\n";
+			out << "    \"latency_ms\": { \"p50\": " << number(latin_latency_histogram::percentile_ms(s.latency, 0.5))
+				<< ", \"p90\": " << number(latin_latency_histogram::percentile_ms(s.latency, 0.9))
+				<< ", \"p99\": " << number(latin_latency_histogram::percentile_ms(s.latency, 0.99)) << " }\n";
+			out << "  }" << (v < 2 ? "," : "") << "\n";
+		}
+		out << "}\n";
+	}
+
+	void clear_stats() {
+		{
+			std::lock_guard<std::mutex> lock(g_statsMutex);
+			g_lastRunStats = latin_stats();
+			g_sessionStats = latin_stats();
+			g_totalStats = latin_stats();
+			g_totalStatsLoaded = true;
+		}
+		// After any totals a finishing run has queued for the main thread.
+		fb2k::inMainThread([] { cfg_stats_totals = ""; });
+	}
+
 	void clear_cache() {
 		g_db.ensure_loaded();
 		g_db.clear_all();
 		g_db.save_if_dirty();
+		g_db.dispatch_index_refresh();
 	}
 
 	bool test_latinize(const char* title, const char* album, pfc::string8& outTitle, pfc::string8& outAlbum, pfc::string8& outError, pfc::string8& outRaw) {
@@ -865,55 +5130,18 @@ namespace foo_latinize {
 			[](threaded_process_callback::ctx_t) {},
 			[items, changed](threaded_process_status& status, abort_callback& abort) {
 				// Worker thread: compute missing latinized values and update cache.
-				const t_size count = items->get_count();
-				status.set_progress(0, count);
-
-				for (t_size i = 0; i < count; ++i) {
-					abort.check();
-					status.set_progress(i, count);
-
-					metadb_handle_ptr handle = (*items)[i];
-					metadb_info_container::ptr infoContainer;
-					if (!handle->get_info_ref(infoContainer)) continue;
-
-					const file_info& info = infoContainer->info();
-					const char* title = info.meta_get("TITLE", 0);
-					const char* album = info.meta_get("ALBUM", 0);
-
-					const auto trackHash = get_keyer().hash_track(info, handle->get_location());
-					const auto albumHash = get_keyer().hash_album(info, handle->get_location());
-					pfc::string8 cachedAlbum;
-					const bool haveAlbum = g_db.get_album(albumHash, cachedAlbum) && cachedAlbum.length() > 0;
-
-					latin_record rec;
-					const bool have = g_db.get_track(trackHash, rec);
-					if (have && rec.title.length() > 0 && (rec.album.length() > 0 || haveAlbum)) {
-						// Ensure album cache is populated from track record if needed
-						if (!haveAlbum && rec.album.length() > 0) g_db.set_album(albumHash, rec.album);
-						continue;
-					}
-
-					latin_record fresh;
-					if (!request_latinized(title, album, fresh, abort)) continue;
-
-					if (fresh.title.length() == 0 && fresh.album.length() == 0) continue;
-
-					// Prefer existing album cache to keep album naming consistent within the same album
-					if (haveAlbum) {
-						fresh.album = cachedAlbum;
-					}
-
-					g_db.set_track(trackHash, fresh);
-					if (!haveAlbum && fresh.album.length() > 0) g_db.set_album(albumHash, fresh.album);
-
-					changed->add_item(handle);
+				// The journal replaces any earlier unfinished job, and is only
+				// emptied once every item in it has a result.
+				const pfc::string8 path = job_path();
+				write_item_list(path, job_magic, *items);
+				if (latinize_items(*items, get_concurrency(), &status, abort, *changed) == 0) {
+					write_item_list(path, job_magic, metadb_handle_list());
 				}
-				g_db.save_if_dirty();
 			},
 			[changed](threaded_process_callback::ctx_t, bool) {
 				// UI thread: refresh metadata for changed items.
 				if (changed->get_count() == 0) return;
-				static_api_ptr_t<metadb_io>()->dispatch_refresh(*changed);
+				refresh_changed(*changed);
 				FB2K_console_formatter() << "[foo_sample latinize] Updated " << changed->get_count() << " item(s).";
 			}
 		);
@@ -923,6 +5151,26 @@ namespace foo_latinize {
 			parent, "Latinize names");
 	}
 
+	bool HasPendingLatinizeJob() {
+		abort_callback_dummy abort;
+		try {
+			return filesystem::g_exists(job_path(), abort);
+		} catch (exception_io const&) {
+			return false;
+		}
+	}
+
+	void ResumeLatinizeJob(fb2k::hwnd_t parent) {
+		metadb_handle_list items;
+		read_item_list(job_path(), job_magic, items);
+		if (items.get_count() == 0) {
+			FB2K_console_formatter() << "[latinize] No unfinished latinize job to resume.";
+			return;
+		}
+		FB2K_console_formatter() << "[latinize] Resuming latinize job: " << items.get_count() << " item(s).";
+		RunLatinize(items, parent);
+	}
+
 	void ClearLatinizeAll(metadb_handle_list_cref data, fb2k::hwnd_t parent) {
 		// Removes both title and album latinized values for selected items.
 		if (data.get_count() == 0) return;
@@ -952,6 +5200,10 @@ namespace foo_latinize {
 					bool anyChanged = false;
 					if (g_db.delete_entry(true, trackHash)) anyChanged = true;
 					if (g_db.delete_entry(false, albumHash)) anyChanged = true;
+					forget_source_text(info, "TITLE");
+					forget_source_text(info, "ALBUM");
+					// Clearing also forgets an earlier failure, so the next run retries.
+					g_db.delete_negative(trackHash);
 
 					if (anyChanged) changed->add_item(handle);
 				}
@@ -959,7 +5211,7 @@ namespace foo_latinize {
 			},
 			[changed](threaded_process_callback::ctx_t, bool) {
 				if (changed->get_count() == 0) return;
-				static_api_ptr_t<metadb_io>()->dispatch_refresh(*changed);
+				refresh_changed(*changed);
 				FB2K_console_formatter() << "[foo_sample latinize] Cleared " << changed->get_count() << " item(s).";
 			}
 		);
@@ -992,6 +5244,7 @@ namespace foo_latinize {
 
 					const file_info& info = infoContainer->info();
 					const auto trackHash = get_keyer().hash_track(info, handle->get_location());
+					forget_source_text(info, "TITLE");
 
 					latin_record rec;
 					if (!g_db.get_track(trackHash, rec)) continue;
@@ -1004,7 +5257,7 @@ namespace foo_latinize {
 			},
 			[changed](threaded_process_callback::ctx_t, bool) {
 				if (changed->get_count() == 0) return;
-				static_api_ptr_t<metadb_io>()->dispatch_refresh(*changed);
+				refresh_changed(*changed);
 				FB2K_console_formatter() << "[foo_sample latinize] Cleared titles for " << changed->get_count() << " item(s).";
 			}
 		);
@@ -1052,6 +5305,7 @@ namespace foo_latinize {
 					if (g_db.delete_entry(false, albumHash)) {
 						anyChanged = true;
 					}
+					forget_source_text(info, "ALBUM");
 
 					if (anyChanged) changed->add_item(handle);
 				}
@@ -1059,7 +5313,7 @@ namespace foo_latinize {
 			},
 			[changed](threaded_process_callback::ctx_t, bool) {
 				if (changed->get_count() == 0) return;
-				static_api_ptr_t<metadb_io>()->dispatch_refresh(*changed);
+				refresh_changed(*changed);
 				FB2K_console_formatter() << "[foo_sample latinize] Cleared albums for " << changed->get_count() << " item(s).";
 			}
 		);
@@ -1069,3 +5323,8 @@ namespace foo_latinize {
 			parent, "Clear latinized albums");
 	}
 }
+
+#ifdef LATINIZE_BENCH
+// Developer benchmarks and reference implementations (Bench configuration).
+#include "latinize_bench.inl"
+#endif
@@ -8,6 +8,13 @@ namespace foo_latinize {
 		metadb_index_hash hash = 0;
 		pfc::string8 title;
 		pfc::string8 album;
+		// Track that could not be latinized and is skipped by runs for now;
+		// `status` describes why and until when. Title/album are empty.
+		bool is_negative = false;
+		pfc::string8 status;
+		// Shared string (a latinized title or album text, keyed by its source
+		// text); the value is in `title`.
+		bool is_text = false;
 	};
 
 	// Config variables (stored in foobar2000 config)
@@ -16,11 +23,52 @@ namespace foo_latinize {
 	extern cfg_string cfg_api_model;
 	extern cfg_string cfg_prompt;
 	extern cfg_string cfg_db_path;
+	extern cfg_string cfg_batch_prompt;
+	extern cfg_uint cfg_concurrency;
+	extern cfg_uint cfg_batch_size;
+	extern cfg_uint cfg_rate_rpm;
+	extern cfg_uint cfg_rate_tpm;
+	extern cfg_uint cfg_fast_keys;
+	extern cfg_uint cfg_index_storage;
+	extern cfg_uint cfg_stream;
+	extern cfg_uint cfg_local_engine;
+	extern cfg_uint cfg_auto_latinize;
+	extern cfg_uint cfg_auto_threads;
+	extern cfg_uint cfg_auto_pause_playback;
+	extern cfg_uint cfg_negative_ttl;
+	extern cfg_uint cfg_keep_alive;
+	extern cfg_uint cfg_http2;
 
 	// Defaults (used by preferences reset)
 	const char* default_api_url();
 	const char* default_api_model();
 	const char* default_prompt();
+	const char* default_batch_prompt();
+	t_uint32 default_concurrency();
+	t_uint32 default_batch_size();
+	t_uint32 default_rate_rpm();
+	t_uint32 default_rate_tpm();
+	t_uint32 default_fast_keys();
+	t_uint32 default_index_storage();
+	t_uint32 default_stream();
+	t_uint32 default_local_engine();
+	t_uint32 default_auto_latinize();
+	t_uint32 default_auto_threads();
+	t_uint32 default_auto_pause_playback();
+	t_uint32 default_negative_ttl();
+	t_uint32 default_keep_alive();
+	t_uint32 default_http2();
+
+	// Limits enforced on numeric settings.
+	enum {
+		concurrency_min = 1,
+		concurrency_max = 32,
+		batch_size_min = 1,
+		batch_size_max = 100,
+		rate_rpm_max = 100000,
+		rate_tpm_max = 100000000,
+		negative_ttl_max = 365,
+	};
 
 	// Effective values
 	pfc::string8 get_db_path();
@@ -29,13 +77,37 @@ namespace foo_latinize {
 	void get_cache_snapshot(pfc::list_t<cache_entry>& out);
 	bool update_cache_entry(const cache_entry& entry);
 	bool delete_cache_entry(bool is_track, metadb_index_hash hash);
+	// Forgets a skipped track, so the next run asks for it again.
+	bool delete_negative_entry(metadb_index_hash hash);
+	bool delete_text_entry(metadb_index_hash hash);
 	void clear_cache();
+	// Reopens the cache if the DB path setting changed.
+	void reload_cache();
+	// Rebuilds the request endpoint and templates after the API settings changed.
+	void reload_request_settings();
+
+	// Run telemetry (Latinize Stats page): one row per metric, valued for the
+	// last run, this session and all sessions. Empty values mean no run yet.
+	struct stats_row {
+		pfc::string8 name;
+		pfc::string8 last_run;
+		pfc::string8 session;
+		pfc::string8 all_time;
+	};
+	void get_stats_rows(pfc::list_t<stats_row>& out);
+	// The same counters as a JSON document.
+	void get_stats_json(pfc::string8& out);
+	// Forgets the last run, session and all-time counters.
+	void clear_stats();
 
 	// Manual test helper
 	bool test_latinize(const char* title, const char* album, pfc::string8& outTitle, pfc::string8& outAlbum, pfc::string8& outError, pfc::string8& outRaw);
 
 	// Command entry point
 	void RunLatinize(metadb_handle_list_cref data, fb2k::hwnd_t parent);
+	// Unfinished RunLatinize job left by an abort, a failure or a crash.
+	bool HasPendingLatinizeJob();
+	void ResumeLatinizeJob(fb2k::hwnd_t parent);
 	void ClearLatinizeAll(metadb_handle_list_cref data, fb2k::hwnd_t parent);
 	void ClearLatinizeTitleOnly(metadb_handle_list_cref data, fb2k::hwnd_t parent);
 	void ClearLatinizeAlbumOnly(metadb_handle_list_cref data, fb2k::hwnd_t parent);
@@ -0,0 +1,899 @@
+// Developer benchmarks for latinize.cpp, built only in the Bench
+// configuration (LATINIZE_BENCH) and included at the end of latinize.cpp so
+// they can drive its internals. Nothing here ships in the component: the
+// reference implementations below exist only to be compared against, and
+// the commands are registered under their own "Latinize Bench" menus.
+
+namespace {
+	static pfc::string8 replace_token(pfc::string8 src, const char* token, const char* value) {
+		pfc::string8 out;
+		const char* p = src.c_str();
+		const size_t tokenLen = strlen(token);
+		while (*p) {
+			const char* hit = strstr(p, token);
+			if (!hit) {
+				out.add_string(p);
+				break;
+			}
+			out.add_string(p, hit - p);
+			out.add_string(value);
+			p = hit + tokenLen;
+		}
+		return out;
+	}
+
+	// Straightforward body construction: resolves the prompt with replace_token()
+	// and escapes it whole. Requests use latin_body_template, which must produce
+	// the same bytes; this is the reference the key benchmark checks it against.
+	static void build_reference_body(const char* model, const char* tmpl, std::initializer_list<const char*> tokens,
+		const char* const* values, bool stream, pfc::string8& body) {
+		latin_prompt prompt;
+		split_prompt_template(tmpl, tokens, prompt);
+		size_t index = 0;
+		for (const char* token : tokens) prompt.payload = replace_token(prompt.payload, token, values[index++]);
+
+		body.reset();
+		body << "{";
+		body << "\"model\":\"" << json_escape(model) << "\",";
+		body << "\"messages\":[";
+		body << "{\"role\":\"system\",\"content\":\"You produce latinized ASCII-only names.";
+		if (prompt.instructions.length() > 0) body << "\\n\\n" << json_escape(prompt.instructions.c_str());
+		body << "\"},";
+		body << "{\"role\":\"user\",\"content\":\"" << json_escape(prompt.payload.c_str()) << "\"}";
+		body << "],";
+		body << "\"stream\":" << (stream ? "true" : "false") << ",";
+		if (stream) body << "\"stream_options\":{\"include_usage\":true},";
+		body << "\"temperature\":0.2";
+		body << "}";
+	}
+
+	// Synthetic library for the offline benchmark. Albums hold 12 tracks;
+	// titles and album names are drawn from Latin, kana, kanji-with-kana and
+	// hanzi word pools and numbered so they stay distinct, except that every
+	// seventh title repeats an earlier one (covers, live and remastered
+	// versions), which gives the string cache its usual share of repeats.
+	struct bench_track {
+		pfc::string8 title;
+		pfc::string8 album;
+	};
+
+	static void make_bench_library(size_t count, std::vector<bench_track>& out) {
+		static const char* const pools[][8] = {
+			{ "Love", "Night", "Summer", "Dream", "Blue", "Heart", "Rain", "City" },
+			{ "\xE3\x81\x95\xE3\x81\x8F\xE3\x82\x89", "\xE3\x81\xB2\xE3\x81\x8B\xE3\x82\x8A", "\xE3\x81\xAA\xE3\x81\xBF\xE3\x81\xA0",
+				"\xE3\x82\xAB\xE3\x83\xA1\xE3\x83\xA9", "\xE3\x83\xA1\xE3\x83\xAD\xE3\x83\x87\xE3\x82\xA3", "\xE3\x82\x86\xE3\x82\x81",
+				"\xE3\x81\xA8\xE3\x82\x82\xE3\x81\xA0\xE3\x81\xA1", "\xE3\x81\x86\xE3\x81\x9F" },   // sakura hikari namida kamera merodi yume tomodachi uta
+			{ "\xE5\xBF\x83\xE3\x81\xAE\xE5\xA3\xB0", "\xE5\xA4\x9C\xE3\x81\xAB\xE9\xA7\x86\xE3\x81\x91\xE3\x82\x8B", "\xE5\x90\x9B\xE3\x81\xAE\xE5\x90\x8D",
+				"\xE7\xA9\xBA\xE3\x81\xA8\xE6\xB5\xB7", "\xE8\x8A\xB1\xE3\x81\xAE\xE6\xAD\x8C", "\xE9\xA2\xA8\xE3\x81\xAE\xE8\xA1\x97",
+				"\xE6\x98\x9F\xE3\x81\xAB\xE9\xA1\x98\xE3\x81\x84\xE3\x82\x92", "\xE9\x9B\xA8\xE3\x81\xAE\xE6\x97\xA5" },   // kokoro no koe, yoru ni kakeru ...
+			{ "\xE9\x9D\x92\xE8\x8A\xB1\xE7\x93\xB7", "\xE5\xA4\x9C\xE6\x9B\xB2", "\xE7\xA8\xBB\xE9\xA6\x99", "\xE6\x99\xB4\xE5\xA4\xA9",
+				"\xE6\x9C\x88\xE4\xBA\xAE", "\xE5\x90\x8E\xE6\x9D\xA5", "\xE5\x8F\x8B\xE8\xB0\x8A", "\xE6\xB5\xB7\xE9\xB8\x9F" },   // qinghuaci yequ daoxiang ...
+		};
+		std::mt19937 rng(20240611);
+		auto words = [&rng](pfc::string8& out, size_t pool, size_t count) {
+			for (size_t i = 0; i < count; ++i) {
+				if (i > 0 && pool == 0) out << " ";
+				out << pools[pool][rng() % 8];
+			}
+		};
+		out.resize(count);
+		pfc::string8 album;
+		for (size_t i = 0; i < count; ++i) {
+			if (i % 12 == 0) {
+				album.reset();
+				words(album, rng() % 4, 2);
+				album << " " << (t_uint64)(i / 12 + 1);
+			}
+			out[i].album = album;
+			if (i % 7 == 6) {
+				out[i].title = out[rng() % i].title;
+				continue;
+			}
+			words(out[i].title, rng() % 4, 1 + rng() % 3);
+			out[i].title << " " << (t_uint64)(i + 1);
+		}
+	}
+
+	// The text helpers as they were before they were tuned (per-line copies,
+	// per-character appends, strlen re-scans). Kept only as the reference
+	// BenchmarkLatinizeText() checks the current versions against.
+	static void trim_ascii_reference(pfc::string8& s) {
+		const char* p = s.c_str();
+		size_t start = 0;
+		size_t end = strlen(p);
+		while (start < end && (unsigned char)p[start] <= 0x20) ++start;
+		while (end > start && (unsigned char)p[end - 1] <= 0x20) --end;
+		if (start == 0 && end == strlen(p)) return;
+		pfc::string8 tmp;
+		tmp.add_string(p + start, end - start);
+		s = tmp;
+	}
+
+	static pfc::string8 sanitize_latin_reference(const char* in) {
+		pfc::string8 out;
+		bool prev_space = false;
+		for (const char* p = in; *p; ++p) {
+			const char c = *p;
+			if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')) {
+				out.add_char((char)tolower((unsigned char)c));
+				prev_space = false;
+			} else if (c >= '0' && c <= '9') {
+				out.add_char(c);
+				prev_space = false;
+			} else if (c == ' ' || c == '\t' || c == '-' || c == '_' || c == '.') {
+				if (!prev_space && out.length() > 0) {
+					out.add_char(' ');
+					prev_space = true;
+				}
+			}
+		}
+		trim_ascii_reference(out);
+		return out;
+	}
+
+	static bool match_key_ci_reference(const char* s, const char* key, size_t& consumed) {
+		if (!key) return false;
+		size_t i = 0;
+		while (s[i] == ' ' || s[i] == '\t') ++i;
+		size_t j = 0;
+		while (key[j] && s[i]) {
+			char c = s[i];
+			if (c == ' ' || c == '\t' || c == '_' || c == '-') { ++i; continue; }
+			char a = (char)tolower((unsigned char)c);
+			char b = (char)tolower((unsigned char)key[j]);
+			if (a != b) return false;
+			++i;
+			++j;
+		}
+		if (key[j] != 0) return false;
+		consumed = i;
+		return true;
+	}
+
+	static const char* skip_separators_reference(const char* p) {
+		while (*p == ' ' || *p == '\t' || *p == ':' || *p == '-' ) ++p;
+		return p;
+	}
+
+	static latin_field classify_latin_line_reference(const char* s, size_t* index, pfc::string8& value) {
+		if (index) {
+			while (*s == ' ' || *s == '\t') ++s;
+			if (*s < '0' || *s > '9') return field_none;
+			size_t n = 0;
+			while (*s >= '0' && *s <= '9') {
+				n = n * 10 + (size_t)(*s - '0');
+				if (n > 100000) return field_none;
+				++s;
+			}
+			while (*s == '.' || *s == ')' || *s == ':' || *s == ' ' || *s == '\t') ++s;
+			*index = n;
+		}
+		size_t consumed = 0;
+		latin_field which;
+		if (match_key_ci_reference(s, "titlelatin", consumed)) which = field_title;
+		else if (match_key_ci_reference(s, "albumlatin", consumed)) which = field_album;
+		else return field_none;
+		value = skip_separators_reference(s + consumed);
+		trim_ascii_reference(value);
+		return which;
+	}
+
+	static bool parse_latin_lines_reference(const pfc::string8& text, latin_record& out) {
+		const char* p = text.c_str();
+		pfc::string8 t, a;
+		while (*p) {
+			while (*p == '\r' || *p == '\n') ++p;
+			const char* lineStart = p;
+			while (*p && *p != '\r' && *p != '\n') ++p;
+			pfc::string8 line;
+			line.add_string(lineStart, p - lineStart);
+			pfc::string8 value;
+			switch (classify_latin_line_reference(line, nullptr, value)) {
+			case field_title: t = value; break;
+			case field_album: a = value; break;
+			default: break;
+			}
+		}
+		out.title = sanitize_latin_reference(t.c_str());
+		out.album = sanitize_latin_reference(a.c_str());
+		return out.title.length() > 0 || out.album.length() > 0;
+	}
+
+	static size_t parse_latin_lines_reference(const pfc::string8& text, std::vector<latin_record>& out, std::vector<char>& found) {
+		const size_t count = out.size();
+		std::vector<pfc::string8> titles(count), albums(count);
+		std::vector<char> seenTitle(count, 0), seenAlbum(count, 0);
+		const char* p = text.c_str();
+		while (*p) {
+			while (*p == '\r' || *p == '\n') ++p;
+			const char* lineStart = p;
+			while (*p && *p != '\r' && *p != '\n') ++p;
+			pfc::string8 line;
+			line.add_string(lineStart, p - lineStart);
+			pfc::string8 value;
+			size_t index = 0;
+			const latin_field which = classify_latin_line_reference(line, &index, value);
+			if (which == field_none || index < 1 || index > count) continue;
+			if (which == field_title) {
+				titles[index - 1] = value;
+				seenTitle[index - 1] = 1;
+			} else {
+				albums[index - 1] = value;
+				seenAlbum[index - 1] = 1;
+			}
+		}
+
+		found.assign(count, 0);
+		size_t total = 0;
+		for (size_t i = 0; i < count; ++i) {
+			if (!seenTitle[i] || !seenAlbum[i]) continue;
+			out[i].title = sanitize_latin_reference(titles[i].c_str());
+			out[i].album = sanitize_latin_reference(albums[i].c_str());
+			if (out[i].title.length() == 0 && out[i].album.length() == 0) continue;
+			found[i] = 1;
+			++total;
+		}
+		return total;
+	}
+
+	static pfc::string8 json_escape_reference(const char* in) {
+		pfc::string8 out;
+		for (const char* p = in; *p; ++p) {
+			const unsigned char b = (unsigned char)*p;
+			switch (b) {
+			case '\\': out.add_string("\\\\"); break;
+			case '"': out.add_string("\\\""); break;
+			case '\n': out.add_string("\\n"); break;
+			case '\r': out.add_string("\\r"); break;
+			case '\t': out.add_string("\\t"); break;
+			default:
+				if (b < 0x20) {
+					// Control characters -> space
+					out.add_char(' ');
+				} else if (b < 0x80) {
+					out.add_char((char)b);
+				} else {
+					out.add_string((const char*)p, 1);
+				}
+				break;
+			}
+		}
+		return out;
+	}
+
+	// Discards field output, counting bytes so benchmark work stays observable.
+	class null_text_out : public titleformat_text_out {
+	public:
+		void write(const GUID&, const char*, t_size dataLength) override { length += dataLength; }
+		t_size length = 0;
+	};
+}
+
+namespace foo_latinize {
+	static void BenchmarkLatinize(metadb_handle_list_cref data, fb2k::hwnd_t parent) {
+		if (data.get_count() == 0) return;
+		g_db.ensure_loaded();
+
+		auto items = std::make_shared<metadb_handle_list>(data);
+
+		auto task = threaded_process_callback_lambda::create(
+			[](threaded_process_callback::ctx_t) {},
+			[items](threaded_process_status& status, abort_callback& abort) {
+				// Collect info up front so only key derivation and lookups are timed.
+				std::vector<metadb_info_container::ptr> infos;
+				metadb_handle_list handles;
+				for (t_size i = 0; i < items->get_count(); ++i) {
+					metadb_info_container::ptr infoContainer;
+					if (!(*items)[i]->get_info_ref(infoContainer)) continue;
+					infos.push_back(infoContainer);
+					handles.add_item((*items)[i]);
+				}
+				const size_t rows = infos.size();
+				if (rows == 0) return;
+				// Small selections are repeated so each measurement is long enough to time.
+				const size_t passes = pfc::max_t<size_t>(1, 20000 / rows);
+
+				// Key derivation as it was before keys were cached: fresh buffer,
+				// service lookup and MD5 for every key.
+				titleformat_object::ptr legacyTrack, legacyAlbum;
+				static_api_ptr_t<titleformat_compiler>()->compile_safe_ex(legacyTrack, "%artist% - %title% - %album%");
+				static_api_ptr_t<titleformat_compiler>()->compile_safe_ex(legacyAlbum, "%album%");
+				auto legacyHash = [](const titleformat_object::ptr& script, const file_info& info, const playable_location& location) {
+					pfc::string_formatter s;
+					script->run_simple(location, &info, s);
+					return static_api_ptr_t<hasher_md5>()->process_single_string(s).xorHalve();
+				};
+
+				auto snap = g_db.read();
+				auto& keyer = get_keyer();
+				// Keeps the results observable so the loops are not optimized out.
+				volatile metadb_index_hash sink = 0;
+				size_t step = 0;
+				// Returns nanoseconds per row; each row derives both keys, as the
+				// two display fields do.
+				auto measure = [&](const char* label, auto&& row) {
+					status.set_item(label);
+					status.set_progress(step++, 7);
+					const auto start = std::chrono::steady_clock::now();
+					for (size_t pass = 0; pass < passes; ++pass) {
+						abort.check();
+						for (size_t i = 0; i < rows; ++i) sink = sink ^ row(i, infos[i]->info(), handles[i]->get_location());
+					}
+					const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+					FB2K_console_formatter() << "[latinize]   " << label << ": " << pfc::format_float(ns / (double)(rows * passes), 0, 1) << " ns/row";
+				};
+
+				FB2K_console_formatter() << "[latinize] Key benchmark: " << rows << " row(s) x " << passes << " pass(es)";
+				measure("uncached keys, MD5", [&](size_t, const file_info& info, const playable_location& location) {
+					return legacyHash(legacyTrack, info, location) ^ legacyHash(legacyAlbum, info, location);
+				});
+				measure("cached keys, MD5", [&](size_t, const file_info& info, const playable_location& location) {
+					return keyer.hash_track(info, location, key_md5) ^ keyer.hash_album(info, location, key_md5);
+				});
+				measure("cached keys, XXH64", [&](size_t, const file_info& info, const playable_location& location) {
+					return keyer.hash_track(info, location, key_xxh64) ^ keyer.hash_album(info, location, key_xxh64);
+				});
+				// Both display fields against the loaded DB, with its key scheme.
+				measure("field lookups", [&](size_t, const file_info& info, const playable_location& location) {
+					metadb_index_hash found = 0;
+					if (g_index.active()) {
+						latin_record rec;
+						pfc::string8 album;
+						if (g_index.get_track(keyer.hash_track(info, location), rec)) found += rec.title.length();
+						if (g_index.get_album(keyer.hash_album(info, location), album)) found += album.length();
+						return found;
+					}
+					latin_text title, album;
+					if (snap->find_track(keyer.hash_track(info, location), title, album)) found += title.length;
+					if (snap->find_album(keyer.hash_album(info, location), album)) found += album.length;
+					return found;
+				});
+				// The display path: per-handle memo (warm after the first pass).
+				measure("memoized fields", [&](size_t i, const file_info& info, const playable_location&) {
+					null_text_out out;
+					g_memo.write_field(0, handles[i].get_ptr(), info, *snap, &out);
+					g_memo.write_field(1, handles[i].get_ptr(), info, *snap, &out);
+					return out.length;
+				});
+
+				// Request bodies for single-item requests built from the selection's
+				// tags: as before (replace_token, then escaping the whole prompt)
+				// and from the compiled template. Both must agree byte for byte
+				// unless a tag value itself contains a placeholder.
+				std::vector<pfc::string8> titles(rows), albums(rows);
+				for (size_t i = 0; i < rows; ++i) {
+					const char* title = infos[i]->info().meta_get("title", 0);
+					const char* album = infos[i]->info().meta_get("album", 0);
+					titles[i] = title ? title : "";
+					albums[i] = album ? album : "";
+				}
+				const auto settings = get_request_settings();
+				const pfc::string8 model = cfg_api_model.get();
+				const pfc::string8 prompt = cfg_prompt.get();
+				size_t mismatches = 0;
+				{
+					pfc::string8 expected, actual;
+					for (size_t i = 0; i < rows; ++i) {
+						const char* values[] = { titles[i].c_str(), albums[i].c_str() };
+						build_reference_body(model.c_str(), prompt.c_str(), { "{title}", "{album}" }, values, false, expected);
+						settings->single.build(values, false, actual);
+						if (expected != actual) ++mismatches;
+					}
+				}
+				const size_t bodies = 10000;
+				FB2K_console_formatter() << "[latinize] Request body benchmark: " << bodies << " bodies, "
+					<< mismatches << " mismatch(es) against the reference";
+				auto measureBodies = [&](const char* label, auto&& build) {
+					status.set_item(label);
+					status.set_progress(step++, 7);
+					pfc::string8 body;
+					size_t bytes = 0;
+					const auto start = std::chrono::steady_clock::now();
+					for (size_t n = 0; n < bodies; ++n) {
+						if ((n & 1023) == 0) abort.check();
+						const size_t i = n % rows;
+						const char* values[] = { titles[i].c_str(), albums[i].c_str() };
+						build(values, body);
+						bytes += body.length();
+					}
+					const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+					sink = sink ^ bytes;
+					FB2K_console_formatter() << "[latinize]   " << label << ": " << pfc::format_float(ns / (double)bodies, 0, 1)
+						<< " ns/body, " << (t_uint64)(bytes / bodies) << " bytes/body";
+				};
+				measureBodies("replace_token bodies", [&](const char* const* values, pfc::string8& body) {
+					build_reference_body(model.c_str(), prompt.c_str(), { "{title}", "{album}" }, values, false, body);
+				});
+				measureBodies("compiled template bodies", [&](const char* const* values, pfc::string8& body) {
+					settings->single.build(values, false, body);
+				});
+			},
+			[](threaded_process_callback::ctx_t, bool) {}
+		);
+
+		threaded_process::g_run_modeless(task,
+			threaded_process::flag_show_abort | threaded_process::flag_show_item | threaded_process::flag_show_progress | threaded_process::flag_no_focus,
+			parent, "Latinize benchmark");
+	}
+
+	static void BenchmarkLatinizeOffline(size_t tracks, fb2k::hwnd_t parent) {
+		// Current prompts and model against the mock API: the configured
+		// mock:// URL when there is one, otherwise a provider-like default.
+		// Only this benchmark reaches the mock; get_transport() refuses it.
+		// Its own limiter and meters keep the simulated traffic out of the
+		// session's rate limiting, error log budget and Latinize Stats page.
+		auto limiter = std::make_shared<latin_rate_limiter>();
+		auto meters = std::make_shared<latin_meters>();
+		auto settings = std::make_shared<latin_request_settings>(*get_request_settings());
+		if (!is_mock_url(settings->url)) settings->url = "mock://api?latency=150&jitter=50&errors=0.5&throttle=0.5&drop=1";
+		settings->authorization.reset();
+		settings->transport = &get_mock_transport();
+		settings->limiter = limiter.get();
+		settings->meters = meters.get();
+
+		auto task = threaded_process_callback_lambda::create(
+			[](threaded_process_callback::ctx_t) {},
+			[settings, limiter, meters, tracks](threaded_process_status& status, abort_callback& abort) {
+				typedef std::chrono::steady_clock clock;
+				auto seconds = [](clock::duration d) { return std::chrono::duration<double>(d).count(); };
+
+				status.set_item("Generating library...");
+				std::vector<bench_track> library;
+				make_bench_library(tracks, library);
+
+				FB2K_console_formatter() << "[latinize] Offline benchmark: " << (t_uint64)tracks << " synthetic track(s) against "
+					<< settings->url << ", " << (t_uint64)get_concurrency() << " thread(s), batches of " << (t_uint64)get_batch_size();
+
+				meters->errorsToLog = errors_logged_per_run;
+
+				// Cold run: plan as RunLatinize does, against an empty string cache
+				// kept in memory so the user's cache is neither read nor written.
+				std::unordered_map<metadb_index_hash, pfc::string8> cache;
+				std::unordered_set<metadb_index_hash> pending;
+				std::vector<latin_job> jobs;
+				const bool useLocal = cfg_local_engine.get() != 0;
+				t_uint64 hits = 0, local = 0, shared = 0;
+				const auto coldStart = clock::now();
+				pfc::string8 romaji;
+				for (size_t i = 0; i < tracks; ++i) {
+					if ((i & 1023) == 0) {
+						abort.check();
+						status.set_progress(i, tracks * 2);
+					}
+					const bench_track& track = library[i];
+					const char* fields[] = { track.title, track.album };
+					metadb_index_hash keys[2];
+					bool need[2];
+					for (size_t f = 0; f < 2; ++f) {
+						keys[f] = hash_source_text(fields[f]);
+						need[f] = false;
+						if (cache.count(keys[f])) ++hits;
+						else if (pending.count(keys[f])) ++shared;
+						else if (useLocal && transliterate_local(fields[f], romaji)) {
+							cache[keys[f]] = sanitize_latin(romaji);
+							++local;
+						} else {
+							need[f] = true;
+						}
+					}
+					if (!need[0] && !need[1]) continue;
+					latin_job job;
+					if (need[0]) job.title = track.title;
+					if (need[1]) job.album = track.album;
+					job.titleKey = keys[0];
+					job.albumHash = keys[1];
+					for (size_t f = 0; f < 2; ++f) {
+						if (need[f]) pending.insert(keys[f]);
+					}
+					jobs.push_back(std::move(job));
+				}
+
+				const size_t batchSize = get_batch_size();
+				const size_t batchCount = (jobs.size() + batchSize - 1) / batchSize;
+				t_uint64 failed = 0;
+				size_t answered = 0;
+				run_pooled(batchCount, get_concurrency(), abort,
+					[&jobs, &abort, &settings, batchSize](size_t n) {
+						const size_t first = n * batchSize;
+						const size_t last = pfc::min_t<size_t>(first + batchSize, jobs.size());
+						request_latinized_batch(*settings, &jobs[first], last - first, abort);
+					},
+					[&](size_t n) {
+						const size_t first = n * batchSize;
+						const size_t last = pfc::min_t<size_t>(first + batchSize, jobs.size());
+						for (size_t j = first; j < last; ++j) {
+							const latin_job& job = jobs[j];
+							if (!job.ok) {
+								++failed;
+								continue;
+							}
+							if (job.title.length() > 0) cache[job.titleKey] = job.result.title;
+							if (job.album.length() > 0) cache[job.albumHash] = job.result.album;
+						}
+						answered = last;
+						status.set_progress(tracks + (jobs.empty() ? tracks : tracks * answered / jobs.size()), tracks * 2);
+					});
+				const double coldSeconds = seconds(clock::now() - coldStart);
+
+				// Warm run: every field again, now from the cache.
+				status.set_item("Warm run...");
+				t_uint64 warmHits = 0;
+				const auto warmStart = clock::now();
+				for (size_t i = 0; i < tracks; ++i) {
+					if ((i & 1023) == 0) abort.check();
+					if (cache.count(hash_source_text(library[i].title))) ++warmHits;
+					if (cache.count(hash_source_text(library[i].album))) ++warmHits;
+				}
+				const double warmSeconds = seconds(clock::now() - warmStart);
+
+				const auto latency = meters->latency.snapshot();
+				const latin_token_stats tokens = meters->tokens.snapshot();
+				const t_uint64 fields = (t_uint64)tracks * 2;
+				auto percent = [](t_uint64 part, t_uint64 whole) { return pfc::format_float(whole ? 100.0 * (double)part / (double)whole : 0, 0, 1); };
+
+				FB2K_console_formatter() << "[latinize]   cold: " << pfc::format_float(coldSeconds, 0, 2) << " s, "
+					<< pfc::format_float(coldSeconds > 0 ? (double)tracks / coldSeconds : 0, 0, 0) << " items/s; fields: "
+					<< hits << " cache hits (" << percent(hits, fields) << "%), " << shared << " shared, " << local << " local, "
+					<< (fields - hits - shared - local) << " API in " << (t_uint64)jobs.size() << " job(s), " << failed << " failed";
+				FB2K_console_formatter() << "[latinize]   requests: " << latin_latency_histogram::count(latency) << ", latency p50 "
+					<< pfc::format_float(latin_latency_histogram::percentile_ms(latency, 0.5), 0, 1) << " ms, p99 "
+					<< pfc::format_float(latin_latency_histogram::percentile_ms(latency, 0.99), 0, 1) << " ms; "
+					<< (t_uint64)meters->bytesSent << " bytes sent, " << (t_uint64)meters->bytesReceived << " received";
+				FB2K_console_formatter() << "[latinize]   tokens: " << tokens.prompt << " prompt (" << tokens.cached << " cached), "
+					<< tokens.completion << " completion";
+				FB2K_console_formatter() << "[latinize]   warm: " << pfc::format_float(warmSeconds * 1000, 0, 1) << " ms, "
+					<< pfc::format_float(warmSeconds > 0 ? (double)tracks / warmSeconds : 0, 0, 0) << " items/s, hit rate "
+					<< percent(warmHits, fields) << "%";
+			},
+			[](threaded_process_callback::ctx_t, bool) {}
+		);
+
+		threaded_process::g_run_modeless(task,
+			threaded_process::flag_show_abort | threaded_process::flag_show_item | threaded_process::flag_show_progress | threaded_process::flag_no_focus,
+			parent, "Latinize offline benchmark");
+	}
+
+	static void BenchmarkLatinizeText(fb2k::hwnd_t parent) {
+		auto task = threaded_process_callback_lambda::create(
+			[](threaded_process_callback::ctx_t) {},
+			[](threaded_process_status& status, abort_callback& abort) {
+				typedef std::chrono::steady_clock clock;
+				status.set_item("Building corpora...");
+
+				// Inputs as they come from the library and the API: tag text
+				// (CJK and Latin), model answers (the local romaji), whole batch
+				// responses with CRLF endings, and stray whitespace, control bytes
+				// and separators around the values.
+				std::vector<bench_track> library;
+				make_bench_library(2000, library);
+				std::vector<pfc::string8> texts, answers;
+				pfc::string8 romaji;
+				for (const bench_track& track : library) {
+					texts.push_back(track.title);
+					texts.push_back(track.album);
+					answers.push_back(transliterate_local(track.title, romaji) ? romaji : track.title);
+				}
+				static const char* const adversarial[] = {
+					"", " ", "\t\r\n", "  Kokoro  No\tKoe  ", "\x01Yoru\x1fNi\x7fKakeru\x02", "--__..::",
+					"  Title-Latin : Sakura  ", "(Live) [2019] Remaster!!", " a  b   c    d ",
+					"\xE5\xBF\x83\xE3\x81\xAE\xE5\xA3\xB0 mixed kana", "trailing space ", "x",
+				};
+				for (const char* text : adversarial) answers.push_back(text);
+
+				const size_t batchItems = 100;
+				std::vector<pfc::string8> responses;
+				for (size_t first = 0; first + batchItems <= answers.size(); first += batchItems) {
+					pfc::string8 response;
+					for (size_t i = 0; i < batchItems; ++i) {
+						const t_uint64 n = i + 1;
+						response << n << ".title_latin: " << answers[first + i] << "\r\n"
+							<< n << ".album_latin: " << answers[(first + i * 7) % answers.size()] << "\r\n";
+					}
+					responses.push_back(response);
+				}
+				std::vector<pfc::string8> singles;
+				for (size_t i = 0; i < answers.size(); ++i) {
+					pfc::string8 response;
+					response << "Title Latin: " << answers[i] << "\nAlbum_Latin - " << answers[(i * 7) % answers.size()] << "\n";
+					singles.push_back(response);
+				}
+
+				// Differential check: the current helpers must give exactly what
+				// the reference versions give, for random bytes and for random
+				// sequences of the fragments the parsers key on.
+				status.set_item("Comparing with the reference helpers...");
+				static const char* const fragments[] = {
+					" ", "\t", "\r", "\n", "\r\n", ":", "-", "_", ".", ")", "1", "2", "10", "99999", "100001",
+					"title", "Title", "TITLE", "latin", "_latin", "album", "Album", "a l b u m", "t-i_t l e",
+					"title_latin", "album_latin", "3.", "x", "\x01", "\x1f", "\x7f", "\"", "\\",
+					"\xE5\xBF\x83", "kokoro no koe", "  ", "..", "--",
+				};
+				const size_t cases = 200000;
+				std::mt19937 rng(20240611);
+				size_t mismatches = 0;
+				std::string input;
+				for (size_t n = 0; n < cases; ++n) {
+					if ((n & 4095) == 0) {
+						abort.check();
+						status.set_progress(n, cases);
+					}
+					input.clear();
+					if (n % 3 == 0) {
+						const size_t length = rng() % 64;
+						for (size_t i = 0; i < length; ++i) input.push_back((char)(1 + rng() % 255));
+					} else {
+						const size_t length = rng() % 40;
+						for (size_t i = 0; i < length; ++i) input += fragments[rng() % PFC_TABSIZE(fragments)];
+					}
+					const pfc::string8 text(input.c_str());
+					bool same = sanitize_latin(text) == sanitize_latin_reference(text)
+						&& json_escape(text) == json_escape_reference(text);
+					latin_record a, b;
+					same = same && parse_latin_lines(text, a) == parse_latin_lines_reference(text, b)
+						&& a.title == b.title && a.album == b.album;
+					std::vector<latin_record> batchA(5), batchB(5);
+					std::vector<char> foundA, foundB;
+					same = same && parse_latin_lines(text, batchA, foundA) == parse_latin_lines_reference(text, batchB, foundB)
+						&& foundA == foundB;
+					for (size_t i = 0; same && i < batchA.size(); ++i) {
+						same = batchA[i].title == batchB[i].title && batchA[i].album == batchB[i].album;
+					}
+					if (!same && mismatches++ < 3) {
+						FB2K_console_formatter() << "[latinize] Text helpers differ from the reference for: " << json_escape(text);
+					}
+				}
+				FB2K_console_formatter() << "[latinize] Text benchmark: " << (t_uint64)mismatches << " mismatch(es) in "
+					<< (t_uint64)cases << " differential case(s)";
+
+				// Reply string decoding: escapes, surrogate pairs and malformed
+				// UTF-8, each fed whole and split into 1- and 3-byte pieces.
+				static const char* const decodeCases[][2] = {
+					{ "\\u00e9\\u5FC3", "\xC3\xA9\xE5\xBF\x83" },
+					{ "\\ud83c\\udfb5", "\xF0\x9F\x8E\xB5" },                      // U+1F3B5
+					{ "a\\ud83cb", "a\xEF\xBF\xBD" "b" },                         // lone high surrogate
+					{ "\\udfb5\\ud83c", "\xEF\xBF\xBD\xEF\xBF\xBD" },              // halves in the wrong order
+					{ "\\ud83c\\ud83c\\udfb5", "\xEF\xBF\xBD\xF0\x9F\x8E\xB5" },
+					{ "\xE5\xBF\x83\xFF\xE5\xBF", "\xE5\xBF\x83\xEF\xBF\xBD\xEF\xBF\xBD\xEF\xBF\xBD" },
+					{ "\xED\xA0\x80", "\xEF\xBF\xBD\xEF\xBF\xBD\xEF\xBF\xBD" },    // encoded surrogate
+					{ "tab\\tquote\\\"slash\\/", "tab\tquote\"slash/" },
+				};
+				size_t decodeMismatches = 0;
+				latin_json_reader reader;
+				for (const auto& c : decodeCases) {
+					pfc::string8 json;
+					json << "{\"choices\":[{\"message\":{\"content\":\"" << c[0] << "\"}}]}";
+					for (size_t piece : { json.length(), (size_t)1, (size_t)3 }) {
+						reader.reset();
+						for (size_t i = 0; i < json.length(); i += piece) {
+							reader.feed(json.get_ptr() + i, pfc::min_t(piece, json.length() - i));
+						}
+						if (!reader.finish() || strcmp(reader.content(), c[1]) != 0) ++decodeMismatches;
+					}
+				}
+				FB2K_console_formatter() << "[latinize] Reply decoding: " << (t_uint64)decodeMismatches << " mismatch(es) in "
+					<< (t_uint64)(PFC_TABSIZE(decodeCases) * 3) << " known-answer case(s)";
+
+				// Timings, reference first, over the same corpora.
+				status.set_item("Timing...");
+				size_t sink = 0;
+				auto measure = [&](const char* label, size_t ops, const std::function<size_t(size_t)>& reference,
+					const std::function<size_t(size_t)>& current) {
+					double ns[2];
+					for (int pass = 0; pass < 2; ++pass) {
+						const auto& fn = pass == 0 ? reference : current;
+						const auto start = clock::now();
+						for (size_t i = 0; i < ops; ++i) {
+							if ((i & 1023) == 0) abort.check();
+							sink += fn(i);
+						}
+						ns[pass] = std::chrono::duration<double, std::nano>(clock::now() - start).count() / (double)ops;
+					}
+					FB2K_console_formatter() << "[latinize]   " << label << ": " << pfc::format_float(ns[0], 0, 1) << " -> "
+						<< pfc::format_float(ns[1], 0, 1) << " ns/op";
+				};
+				measure("sanitize_latin", 200000,
+					[&](size_t i) { return sanitize_latin_reference(answers[i % answers.size()]).length(); },
+					[&](size_t i) { return sanitize_latin(answers[i % answers.size()]).length(); });
+				measure("json_escape", 200000,
+					[&](size_t i) { return json_escape_reference(texts[i % texts.size()]).length(); },
+					[&](size_t i) { return json_escape(texts[i % texts.size()]).length(); });
+				measure("parse_latin_lines (single)", 100000,
+					[&](size_t i) { latin_record r; parse_latin_lines_reference(singles[i % singles.size()], r); return r.title.length(); },
+					[&](size_t i) { latin_record r; parse_latin_lines(singles[i % singles.size()], r); return r.title.length(); });
+				std::vector<latin_record> records;
+				std::vector<char> found;
+				measure("parse_latin_lines (100-item batch)", 2000,
+					[&](size_t i) { records.assign(batchItems, latin_record()); return parse_latin_lines_reference(responses[i % responses.size()], records, found); },
+					[&](size_t i) { records.assign(batchItems, latin_record()); return parse_latin_lines(responses[i % responses.size()], records, found); });
+
+				// Whole replies: the batch responses as sent (raw UTF-8), and with
+				// every non-ASCII character as a \u escape, as some providers send.
+				auto measureReplies = [&](const char* label, bool escapeAll) {
+					std::vector<pfc::string8> replies;
+					size_t bytes = 0;
+					for (const pfc::string8& response : responses) {
+						pfc::string8 reply;
+						reply << "{\"id\":\"bench\",\"choices\":[{\"index\":0,\"message\":{\"role\":\"assistant\",\"content\":\"";
+						if (escapeAll) {
+							for (size_t i = 0; i < response.length(); ) {
+								const unsigned char c = (unsigned char)response[i];
+								if (c < 0x80) {
+									append_json_escaped(reply, response.get_ptr() + i, 1);
+									++i;
+									continue;
+								}
+								unsigned cp = 0;
+								const size_t n = pfc::utf8_decode_char(response.get_ptr() + i, cp);
+								if (n == 0) break;
+								if (cp >= 0x10000) {
+									cp -= 0x10000;
+									reply << "\\u" << pfc::format_hex(0xD800 + (cp >> 10), 4) << "\\u" << pfc::format_hex(0xDC00 + (cp & 0x3FF), 4);
+								} else {
+									reply << "\\u" << pfc::format_hex(cp, 4);
+								}
+								i += n;
+							}
+						} else {
+							append_json_escaped(reply, response.get_ptr(), response.length());
+						}
+						reply << "\"},\"finish_reason\":\"stop\"}]}";
+						bytes += reply.length();
+						replies.push_back(reply);
+					}
+					const size_t rounds = 200;
+					const auto start = clock::now();
+					for (size_t r = 0; r < rounds; ++r) {
+						abort.check();
+						for (const pfc::string8& reply : replies) {
+							read_json(reply.get_ptr(), reply.length(), reader);
+							sink += reader.content().length();
+						}
+					}
+					const double seconds = std::chrono::duration<double>(clock::now() - start).count();
+					FB2K_console_formatter() << "[latinize]   " << label << ": "
+						<< pfc::format_float(seconds > 0 ? (double)bytes * rounds / seconds / 1e6 : 0, 0, 0) << " MB/s";
+				};
+				measureReplies("reply decoding (raw UTF-8)", false);
+				measureReplies("reply decoding (\\u escapes)", true);
+				if (sink == 0) FB2K_console_formatter() << "[latinize]   (no output)";
+			},
+			[](threaded_process_callback::ctx_t, bool) {}
+		);
+
+		threaded_process::g_run_modeless(task,
+			threaded_process::flag_show_abort | threaded_process::flag_show_item | threaded_process::flag_show_progress | threaded_process::flag_no_focus,
+			parent, "Latinize text benchmark");
+	}
+}
+
+namespace {
+	static const GUID guid_latinize_bench_group = { 0xa41f7c92, 0x5e03, 0x4b8d, { 0x96, 0x2a, 0x7d, 0xc1, 0x08, 0xe4, 0x3b, 0x55 } };
+	static contextmenu_group_popup_factory g_latinize_bench_group(
+		guid_latinize_bench_group, contextmenu_groups::root, "Latinize Bench", 0
+	);
+
+	class latinize_bench_context_item : public contextmenu_item_simple {
+	public:
+		enum { cmd_keys = 0, cmd_total };
+
+		GUID get_parent() { return guid_latinize_bench_group; }
+		unsigned get_num_items() { return cmd_total; }
+
+		void get_item_name(unsigned, pfc::string_base& out) {
+			out = "Benchmark latin field lookup";
+		}
+
+		void context_command(unsigned, metadb_handle_list_cref data, const GUID&) {
+			foo_latinize::BenchmarkLatinize(data, core_api::get_main_window());
+		}
+
+		GUID get_item_guid(unsigned) {
+			return GUID{ 0x6e0d3b82, 0xc415, 0x4a9f, { 0x8b, 0x36, 0x1f, 0xd9, 0x72, 0x04, 0xa5, 0xe3 } };
+		}
+
+		bool get_item_description(unsigned, pfc::string_base& out) {
+			out = "Measures per-row cost of computing cache keys and looking up latinized fields for the selected tracks; results go to the console.";
+			return true;
+		}
+	};
+
+	static contextmenu_item_factory_t<latinize_bench_context_item> g_latinize_bench_context_factory;
+
+	// Main menu: Library > Latinize Bench.
+	static const GUID guid_latinize_bench_mainmenu_group = { 0x5f2c8e31, 0x9d47, 0x4a16, { 0xb3, 0x8e, 0x21, 0x6a, 0xf0, 0x94, 0xc7, 0x5d } };
+	static mainmenu_group_popup_factory g_latinize_bench_mainmenu_group(
+		guid_latinize_bench_mainmenu_group, mainmenu_groups::library, mainmenu_commands::sort_priority_dontcare, "Latinize Bench"
+	);
+
+	class latinize_bench_mainmenu_commands : public mainmenu_commands {
+	public:
+		enum { cmd_bench_1k = 0, cmd_bench_10k, cmd_bench_100k, cmd_bench_1m, cmd_bench_text, cmd_total };
+
+		// Synthetic library size of each offline benchmark command.
+		static size_t bench_tracks(t_uint32 index) {
+			switch (index) {
+			case cmd_bench_1k: return 1000;
+			case cmd_bench_10k: return 10000;
+			case cmd_bench_100k: return 100000;
+			default: return 1000000;
+			}
+		}
+
+		t_uint32 get_command_count() override { return cmd_total; }
+
+		GUID get_command(t_uint32 index) override {
+			switch (index) {
+			case cmd_bench_1k:
+				return GUID{ 0x2b8e4f17, 0x6c3a, 0x4d92, { 0x81, 0x5e, 0x0a, 0xc7, 0x39, 0xd4, 0x62, 0xf1 } };
+			case cmd_bench_10k:
+				return GUID{ 0x7d05a3c8, 0x1e94, 0x4b6f, { 0x9c, 0x27, 0x53, 0xe8, 0x0b, 0x1f, 0xa6, 0x4d } };
+			case cmd_bench_100k:
+				return GUID{ 0xc4926e5b, 0x3f71, 0x48a0, { 0xa4, 0x6d, 0x8e, 0x12, 0x5c, 0x97, 0x30, 0xbb } };
+			case cmd_bench_1m:
+				return GUID{ 0x95f1d82e, 0x74b3, 0x4c05, { 0xb9, 0x0a, 0x26, 0x6f, 0xe1, 0x48, 0xc3, 0x7a } };
+			case cmd_bench_text:
+				return GUID{ 0x3e6a09d4, 0xb25f, 0x4e81, { 0x8f, 0x37, 0xd1, 0x5c, 0x02, 0x9b, 0x6e, 0xa3 } };
+			default:
+				uBugCheck();
+			}
+		}
+
+		void get_name(t_uint32 index, pfc::string_base& out) override {
+			switch (index) {
+			case cmd_bench_1k:
+				out = "Offline benchmark: 1k tracks";
+				return;
+			case cmd_bench_10k:
+				out = "Offline benchmark: 10k tracks";
+				return;
+			case cmd_bench_100k:
+				out = "Offline benchmark: 100k tracks";
+				return;
+			case cmd_bench_1m:
+				out = "Offline benchmark: 1M tracks";
+				return;
+			case cmd_bench_text:
+				out = "Benchmark text helpers";
+				return;
+			default:
+				uBugCheck();
+			}
+		}
+
+		bool get_description(t_uint32 index, pfc::string_base& out) override {
+			switch (index) {
+			case cmd_bench_1k:
+			case cmd_bench_10k:
+			case cmd_bench_100k:
+			case cmd_bench_1m:
+				out = "Latinizes a synthetic library against a simulated API (the configured mock:// URL, or a default one) without touching the cache; throughput, latency, hit rates, bytes and tokens go to the console.";
+				return true;
+			case cmd_bench_text:
+				out = "Checks the response parsing, sanitizing and JSON escaping helpers against their original versions on random input, checks reply string decoding on known cases, and times them; results go to the console.";
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		GUID get_parent() override { return guid_latinize_bench_mainmenu_group; }
+
+		void execute(t_uint32 index, service_ptr_t<service_base>) override {
+			switch (index) {
+			case cmd_bench_1k:
+			case cmd_bench_10k:
+			case cmd_bench_100k:
+			case cmd_bench_1m:
+				foo_latinize::BenchmarkLatinizeOffline(bench_tracks(index), core_api::get_main_window());
+				return;
+			case cmd_bench_text:
+				foo_latinize::BenchmarkLatinizeText(core_api::get_main_window());
+				return;
+			default:
+				uBugCheck();
+			}
+		}
+	};
+
+	static mainmenu_commands_factory_t<latinize_bench_mainmenu_commands> g_latinize_bench_mainmenu_factory;
+}
@@ -0,0 +1,246 @@
+#include "stdafx.h"
+#include "transport.h"
+#include "transliterate.h"
+
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_set>
+
+// In-process mock of a chat-completions API. Latinize talks to it through
+// the ordinary transport interface, so request building, rate limiting,
+// retries, streaming and parsing all run as they would against a provider;
+// only the network and the model are simulated. Built only in the Bench
+// configuration and used only by the offline benchmark, which hands it to
+// its requests directly; get_transport() refuses mock:// URLs.
+
+namespace {
+	using foo_latinize::http_response;
+	using foo_latinize::http_transport;
+
+	// Behaviour knobs, read from the URL query string.
+	struct mock_options {
+		double latencyMs = 150;      // mean time to answer
+		double jitterMs = 50;        // answers vary uniformly by +/- this much
+		double errorPercent = 0;     // requests answered with HTTP 500
+		double throttlePercent = 0;  // requests answered with HTTP 429
+		unsigned retryAfter = 1;     // Retry-After sent with 429, seconds
+		double dropPercent = 0;      // batch records left out of an answer
+
+		void parse(const char* url) {
+			const char* p = strchr(url, '?');
+			while (p && *p) {
+				++p;
+				const char* end = p + strcspn(p, "&");
+				const char* eq = (const char*)memchr(p, '=', end - p);
+				if (eq) {
+					const pfc::string8 key(p, eq - p);
+					const double value = pfc::max_t(0.0, atof(pfc::string8(eq + 1, end - eq - 1).c_str()));
+					if (!strcmp(key, "latency")) latencyMs = value;
+					else if (!strcmp(key, "jitter")) jitterMs = value;
+					else if (!strcmp(key, "errors")) errorPercent = value;
+					else if (!strcmp(key, "throttle")) throttlePercent = value;
+					else if (!strcmp(key, "retry_after")) retryAfter = (unsigned)value;
+					else if (!strcmp(key, "drop")) dropPercent = value;
+				}
+				p = *end ? end : nullptr;
+			}
+		}
+	};
+
+	class mock_response : public http_response {
+	public:
+		size_t read(void* buffer, size_t size, abort_callback& abort) override {
+			abort.check();
+			const size_t n = pfc::min_t(size, body.length() - m_pos);
+			memcpy(buffer, body.get_ptr() + m_pos, n);
+			m_pos += n;
+			return n;
+		}
+
+		pfc::string8 body;
+
+	private:
+		size_t m_pos = 0;
+	};
+
+	// Decodes a JSON string whose opening quote precedes `p`. Request bodies
+	// come from latin_body_template, so only the escapes it writes matter.
+	static void read_json_string(const char* p, pfc::string8& out) {
+		out.reset();
+		for (; *p && *p != '"'; ++p) {
+			if (*p != '\\') {
+				out.add_char(*p);
+				continue;
+			}
+			switch (*++p) {
+			case 'n': out.add_char('\n'); break;
+			case 'r': out.add_char('\r'); break;
+			case 't': out.add_char('\t'); break;
+			case 0: return;
+			default: out.add_char(*p); break;
+			}
+		}
+	}
+
+	static bool find_message(const char* body, const char* role, pfc::string8& out) {
+		pfc::string8 marker;
+		marker << "{\"role\":\"" << role << "\",\"content\":\"";
+		const char* hit = strstr(body, marker);
+		if (!hit) return false;
+		read_json_string(hit + marker.length(), out);
+		return true;
+	}
+
+	static void append_json_text(pfc::string8& out, const char* text, size_t length) {
+		for (size_t i = 0; i < length; ++i) {
+			const char c = text[i];
+			if (c == '"' || c == '\\') out.add_char('\\');
+			if (c == '\n') out.add_string("\\n");
+			else if (c != '\r') out.add_char(c);
+		}
+	}
+
+	// What the "model" answers for one value: the local transliteration when
+	// there is one, otherwise a stable stand-in derived from the text.
+	static void latinize_value(const char* text, pfc::string8& out) {
+		out.reset();
+		if (!*text || foo_latinize::transliterate_local(text, out)) return;
+		t_uint32 h = 2166136261u;
+		for (const char* p = text; *p; ++p) h = (h ^ (t_uint8)*p) * 16777619u;
+		out.reset();
+		out << "mock " << pfc::format_hex(h, 8);
+	}
+
+	class mock_transport : public http_transport {
+	public:
+		std::unique_ptr<http_response> post_json(const char* url, const char*,
+			const pfc::string8& body, abort_callback& abort) override {
+			mock_options options;
+			options.parse(url);
+
+			double roll, delayMs;
+			bool cachedPrefix = false;
+			pfc::string8 system, user;
+			find_message(body, "system", system);
+			find_message(body, "user", user);
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				roll = std::uniform_real_distribution<double>(0, 100)(m_rng);
+				delayMs = options.latencyMs + std::uniform_real_distribution<double>(-1, 1)(m_rng) * options.jitterMs;
+				// Provider caches work on whole prefixes; the system message is the
+				// part latinize keeps identical between requests.
+				cachedPrefix = !m_prefixes.insert(std::hash<std::string>()(system.get_ptr())).second;
+			}
+
+			std::unique_ptr<mock_response> reply(new mock_response());
+			if (roll < options.throttlePercent) {
+				// Rate limits are answered before any work is done.
+				abort.sleep(pfc::max_t(delayMs, 0.0) / 20000);
+				reply->status = 429;
+				reply->statusLine = "HTTP/1.1 429 Too Many Requests";
+				reply->contentType = "application/json";
+				reply->retryAfter << options.retryAfter;
+				reply->body = "{\"error\":{\"message\":\"Simulated rate limit\",\"type\":\"rate_limit_error\"}}";
+				return reply;
+			}
+			abort.sleep(pfc::max_t(delayMs, 0.0) / 1000);
+			if (roll < options.throttlePercent + options.errorPercent) {
+				reply->status = 500;
+				reply->statusLine = "HTTP/1.1 500 Internal Server Error";
+				reply->contentType = "application/json";
+				reply->body = "{\"error\":{\"message\":\"Simulated server error\",\"type\":\"server_error\"}}";
+				return reply;
+			}
+
+			pfc::string8 answer;
+			answer_prompt(user, options, answer);
+
+			const t_int64 promptTokens = (t_int64)body.length() / 3;
+			const t_int64 completionTokens = (t_int64)answer.length() / 3;
+			// Hits are counted in whole 64-token blocks, as DeepSeek does.
+			const t_int64 cachedTokens = cachedPrefix ? ((t_int64)system.length() / 3) & ~(t_int64)63 : 0;
+			pfc::string8 usage;
+			usage << "\"usage\":{\"prompt_tokens\":" << promptTokens << ",\"completion_tokens\":" << completionTokens
+				<< ",\"total_tokens\":" << (promptTokens + completionTokens)
+				<< ",\"prompt_cache_hit_tokens\":" << cachedTokens
+				<< ",\"prompt_cache_miss_tokens\":" << (promptTokens - cachedTokens) << "}";
+
+			reply->status = 200;
+			reply->statusLine = "HTTP/1.1 200 OK";
+			pfc::string8& out = reply->body;
+			if (strstr(body, "\"stream\":true")) {
+				// One event per answer line, then the usage chunk and the terminator.
+				reply->contentType = "text/event-stream";
+				const char* p = answer.get_ptr();
+				while (*p) {
+					const char* end = strchr(p, '\n');
+					const size_t length = end ? (size_t)(end - p + 1) : strlen(p);
+					out << "data: {\"choices\":[{\"index\":0,\"delta\":{\"content\":\"";
+					append_json_text(out, p, length);
+					out << "\"}}]}\n\n";
+					p += length;
+				}
+				out << "data: {\"choices\":[{\"index\":0,\"delta\":{},\"finish_reason\":\"stop\"}]}\n\n";
+				if (strstr(body, "\"include_usage\":true")) out << "data: {\"choices\":[]," << usage << "}\n\n";
+				out << "data: [DONE]\n\n";
+			} else {
+				reply->contentType = "application/json";
+				out << "{\"id\":\"mock\",\"object\":\"chat.completion\",\"choices\":[{\"index\":0,\"message\":{\"role\":\"assistant\",\"content\":\"";
+				append_json_text(out, answer.get_ptr(), answer.length());
+				out << "\"},\"finish_reason\":\"stop\"}]," << usage << "}";
+			}
+			return reply;
+		}
+
+		const char* name() const override { return "mock"; }
+
+	private:
+		// Answers the lines of the default prompts: "Title: x" / "Album: y" for
+		// single requests and "N.title: x" / "N.album: y" for batches.
+		void answer_prompt(const pfc::string8& prompt, const mock_options& options, pfc::string8& out) {
+			pfc::string8 line, value, latin;
+			const char* p = prompt.get_ptr();
+			while (*p) {
+				const char* end = p + strcspn(p, "\r\n");
+				line.set_string(p, end - p);
+				p = end;
+				while (*p == '\r' || *p == '\n') ++p;
+
+				const char* s = line.get_ptr();
+				const char* number = s;
+				while (*s >= '0' && *s <= '9') ++s;
+				const bool numbered = s > number && *s == '.';
+				if (numbered) ++s;
+				const char* field;
+				if (!strncmp(s, numbered ? "title: " : "Title: ", 7)) field = "title_latin: ";
+				else if (!strncmp(s, numbered ? "album: " : "Album: ", 7)) field = "album_latin: ";
+				else continue;
+				if (numbered && options.dropPercent > 0) {
+					std::lock_guard<std::mutex> lock(m_mutex);
+					if (std::uniform_real_distribution<double>(0, 100)(m_rng) < options.dropPercent) continue;
+				}
+				value = s + 7;
+				latinize_value(value, latin);
+				if (numbered) out.add_string(number, s - number);
+				out << field << latin << "\n";
+			}
+		}
+
+		std::mutex m_mutex;
+		std::mt19937 m_rng{ 20240611 };
+		std::unordered_set<size_t> m_prefixes;
+	};
+
+	static mock_transport g_mock;
+}
+
+namespace foo_latinize {
+	bool is_mock_url(const char* url) {
+		return url && !strncmp(url, "mock://", 7);
+	}
+
+	http_transport& get_mock_transport() {
+		return g_mock;
+	}
+}
@@ -40,6 +40,7 @@ public:
 		COMMAND_HANDLER_EX(IDC_MODEL, EN_CHANGE, OnEditChange)
 		COMMAND_HANDLER_EX(IDC_PROMPT, EN_CHANGE, OnEditChange)
 		COMMAND_HANDLER_EX(IDC_DB_PATH, EN_CHANGE, OnEditChange)
+		COMMAND_HANDLER_EX(IDC_BATCH_PROMPT, EN_CHANGE, OnEditChange)
 	END_MSG_MAP()
 private:
 	BOOL OnInitDialog(CWindow, LPARAM);
@@ -59,6 +60,7 @@ BOOL CPrefsMain::OnInitDialog(CWindow, LPARAM) {
 	uSetDlgItemText(*this, IDC_MODEL, cfg_api_model.get().c_str());
 	uSetDlgItemText(*this, IDC_PROMPT, cfg_prompt.get().c_str());
 	uSetDlgItemText(*this, IDC_DB_PATH, cfg_db_path.get().c_str());
+	uSetDlgItemText(*this, IDC_BATCH_PROMPT, cfg_batch_prompt.get().c_str());
 	return FALSE;
 }
 
@@ -78,15 +80,30 @@ void CPrefsMain::reset() {
 	uSetDlgItemText(*this, IDC_MODEL, default_api_model());
 	uSetDlgItemText(*this, IDC_PROMPT, default_prompt());
 	uSetDlgItemText(*this, IDC_DB_PATH, "");
+	uSetDlgItemText(*this, IDC_BATCH_PROMPT, default_batch_prompt());
 	OnChanged();
 }
 
 void CPrefsMain::apply() {
-	cfg_api_url = uGetDlgItemText(*this, IDC_API_URL);
-	cfg_api_key = uGetDlgItemText(*this, IDC_API_KEY);
-	cfg_api_model = uGetDlgItemText(*this, IDC_MODEL);
-	cfg_prompt = uGetDlgItemText(*this, IDC_PROMPT);
-	cfg_db_path = uGetDlgItemText(*this, IDC_DB_PATH);
+	// Reopening the cache re-maps the file (or re-walks the index), so only
+	// a new path does that; prompt or API edits just rebuild the templates.
+	const pfc::string8 dbPath = uGetDlgItemText(*this, IDC_DB_PATH);
+	const bool dbPathChanged = dbPath != cfg_db_path.get();
+	bool requestChanged = false;
+	auto store = [this, &requestChanged](cfg_string& var, int id) {
+		const pfc::string8 text = uGetDlgItemText(*this, id);
+		if (text == var.get()) return;
+		var = text;
+		requestChanged = true;
+	};
+	store(cfg_api_url, IDC_API_URL);
+	store(cfg_api_key, IDC_API_KEY);
+	store(cfg_api_model, IDC_MODEL);
+	store(cfg_prompt, IDC_PROMPT);
+	store(cfg_batch_prompt, IDC_BATCH_PROMPT);
+	cfg_db_path = dbPath;
+	if (dbPathChanged) reload_cache();
+	if (requestChanged) reload_request_settings();
 	OnChanged();
 }
 
@@ -96,6 +113,7 @@ bool CPrefsMain::HasChanged() {
 	if (uGetDlgItemText(*this, IDC_MODEL) != cfg_api_model.get()) return true;
 	if (uGetDlgItemText(*this, IDC_PROMPT) != cfg_prompt.get()) return true;
 	if (uGetDlgItemText(*this, IDC_DB_PATH) != cfg_db_path.get()) return true;
+	if (uGetDlgItemText(*this, IDC_BATCH_PROMPT) != cfg_batch_prompt.get()) return true;
 	return false;
 }
 
@@ -167,6 +185,7 @@ BOOL CPrefsCache::OnInitDialog(CWindow, LPARAM) {
 	m_list.InsertColumn(1, L"Hash", LVCFMT_LEFT, 140, 1);
 	m_list.InsertColumn(2, L"Title Latin", LVCFMT_LEFT, 150, 2);
 	m_list.InsertColumn(3, L"Album Latin", LVCFMT_LEFT, 150, 3);
+	m_list.InsertColumn(4, L"Status", LVCFMT_LEFT, 220, 4);
 	RefreshList();
 	return FALSE;
 }
@@ -199,7 +218,10 @@ void CPrefsCache::OnSave(UINT, int, CWindow) {
 void CPrefsCache::OnDelete(UINT, int, CWindow) {
 	if (m_selIndex < 0 || m_selIndex >= (int)m_cache.get_count()) return;
 	const cache_entry& entry = m_cache[m_selIndex];
-	if (delete_cache_entry(entry.is_track, entry.hash)) {
+	const bool deleted = entry.is_negative ? delete_negative_entry(entry.hash)
+		: entry.is_text ? delete_text_entry(entry.hash)
+		: delete_cache_entry(entry.is_track, entry.hash);
+	if (deleted) {
 		RefreshList();
 	}
 }
@@ -224,12 +246,14 @@ void CPrefsCache::RefreshList() {
 	for (t_size i = 0; i < m_cache.get_count(); ++i) {
 		const cache_entry& e = m_cache[i];
 		if (!MatchesFilter(e)) continue;
-		const wchar_t* kind = e.is_track ? L"Track" : L"Album";
+		// Text entries are shared strings; their value shows as the title.
+		const wchar_t* kind = e.is_negative ? L"Skipped" : e.is_text ? L"Text" : e.is_track ? L"Track" : L"Album";
 		pfc::string8 hashStr = pfc::format_hex(e.hash, 16);
 		int idx = m_list.InsertItem((int)i, kind);
 		m_list.SetItemText(idx, 1, pfc::stringcvt::string_wide_from_utf8(hashStr));
 		m_list.SetItemText(idx, 2, pfc::stringcvt::string_wide_from_utf8(e.title));
 		m_list.SetItemText(idx, 3, pfc::stringcvt::string_wide_from_utf8(e.album));
+		m_list.SetItemText(idx, 4, pfc::stringcvt::string_wide_from_utf8(e.status));
 		m_list.SetItemData(idx, (DWORD_PTR)i);
 	}
 	m_selIndex = -1;
@@ -249,6 +273,7 @@ bool CPrefsCache::MatchesFilter(const cache_entry& e) const {
 	if (IsAsciiOnly(m_filter)) {
 		if (ContainsAsciiCI(e.title, m_filter)) return true;
 		if (ContainsAsciiCI(e.album, m_filter)) return true;
+		if (ContainsAsciiCI(e.status, m_filter)) return true;
 		return false;
 	}
 	if (strstr(e.title.c_str(), m_filter.c_str()) != nullptr) return true;
@@ -282,7 +307,7 @@ bool CPrefsCache::ContainsAsciiCI(const pfc::string8& haystack, const pfc::strin
 void CPrefsCache::UpdateSelection() {
 	if (m_selIndex < 0 || m_selIndex >= (int)m_cache.get_count()) return;
 	const cache_entry& e = m_cache[m_selIndex];
-	uSetDlgItemText(*this, IDC_CACHE_KIND, e.is_track ? "Track" : "Album");
+	uSetDlgItemText(*this, IDC_CACHE_KIND, e.is_negative ? "Skipped" : e.is_text ? "Text" : e.is_track ? "Track" : "Album");
 	uSetDlgItemText(*this, IDC_CACHE_HASH, pfc::format_hex(e.hash, 16));
 	uSetDlgItemText(*this, IDC_CACHE_TITLE, e.title);
 	uSetDlgItemText(*this, IDC_CACHE_ALBUM, e.album);
@@ -299,6 +324,97 @@ public:
 
 static preferences_page_factory_t<preferences_page_cache> g_preferences_page_cache_factory;
 
+class CPrefsStats : public CDialogImpl<CPrefsStats>, public preferences_page_instance {
+public:
+	CPrefsStats(preferences_page_callback::ptr) {}
+
+	enum { IDD = IDD_PREFS_STATS };
+
+	t_uint32 get_state() { return preferences_state::dark_mode_supported; }
+	void apply() {}
+	void reset() {}
+
+	BEGIN_MSG_MAP_EX(CPrefsStats)
+		MSG_WM_INITDIALOG(OnInitDialog)
+		COMMAND_ID_HANDLER_EX(IDC_STATS_REFRESH, OnRefresh)
+		COMMAND_ID_HANDLER_EX(IDC_STATS_EXPORT, OnExport)
+		COMMAND_ID_HANDLER_EX(IDC_STATS_CLEAR, OnClear)
+	END_MSG_MAP()
+private:
+	BOOL OnInitDialog(CWindow, LPARAM);
+	void OnRefresh(UINT, int, CWindow);
+	void OnExport(UINT, int, CWindow);
+	void OnClear(UINT, int, CWindow);
+
+	void RefreshList();
+
+	CListViewCtrl m_list;
+	fb2k::CDarkModeHooks m_dark;
+};
+
+BOOL CPrefsStats::OnInitDialog(CWindow, LPARAM) {
+	m_dark.AddDialogWithControls(*this);
+	m_list.Attach(GetDlgItem(IDC_STATS_LIST));
+	m_list.SetExtendedListViewStyle(LVS_EX_FULLROWSELECT | LVS_EX_GRIDLINES);
+	m_list.InsertColumn(0, L"Metric", LVCFMT_LEFT, 170, 0);
+	m_list.InsertColumn(1, L"Last run", LVCFMT_RIGHT, 90, 1);
+	m_list.InsertColumn(2, L"This session", LVCFMT_RIGHT, 90, 2);
+	m_list.InsertColumn(3, L"All time", LVCFMT_RIGHT, 90, 3);
+	RefreshList();
+	return FALSE;
+}
+
+void CPrefsStats::OnRefresh(UINT, int, CWindow) {
+	RefreshList();
+}
+
+void CPrefsStats::OnExport(UINT, int, CWindow) {
+	pfc::string8 path = "latinize-stats.json";
+	if (!uGetOpenFileName(*this, "JSON files|*.json|All files|*.*", 0, "json", "Export Latinize Stats", nullptr, path, TRUE)) return;
+	pfc::string8 json;
+	get_stats_json(json);
+	try {
+		abort_callback_dummy abort;
+		file::ptr f;
+		filesystem::g_open_write_new(f, path, abort);
+		f->write(json.get_ptr(), json.length(), abort);
+		f->commit(abort);
+	} catch (std::exception const& e) {
+		pfc::string8 msg;
+		msg << "Could not write " << path << ": " << e.what();
+		popup_message::g_show(msg, "Latinize Stats");
+	}
+}
+
+void CPrefsStats::OnClear(UINT, int, CWindow) {
+	clear_stats();
+	RefreshList();
+}
+
+void CPrefsStats::RefreshList() {
+	pfc::list_t<stats_row> rows;
+	get_stats_rows(rows);
+	m_list.DeleteAllItems();
+	for (t_size i = 0; i < rows.get_count(); ++i) {
+		const stats_row& r = rows[i];
+		int idx = m_list.InsertItem((int)i, pfc::stringcvt::string_wide_from_utf8(r.name));
+		m_list.SetItemText(idx, 1, pfc::stringcvt::string_wide_from_utf8(r.last_run));
+		m_list.SetItemText(idx, 2, pfc::stringcvt::string_wide_from_utf8(r.session));
+		m_list.SetItemText(idx, 3, pfc::stringcvt::string_wide_from_utf8(r.all_time));
+	}
+}
+
+class preferences_page_stats : public preferences_page_impl<CPrefsStats> {
+public:
+	const char* get_name() { return "Latinize Stats"; }
+	GUID get_guid() {
+		return GUID{ 0x5b7d2e48, 0x0c91, 0x4f3a, { 0xa6, 0x1e, 0x92, 0xd4, 0x3b, 0x78, 0xc5, 0x07 } };
+	}
+	GUID get_parent_guid() { return guid_tools; }
+};
+
+static preferences_page_factory_t<preferences_page_stats> g_preferences_page_stats_factory;
+
 class CPrefsTest : public CDialogImpl<CPrefsTest>, public preferences_page_instance {
 public:
 	CPrefsTest(preferences_page_callback::ptr) {}
@@ -371,4 +487,160 @@ public:
 };
 
 static preferences_page_factory_t<preferences_page_test> g_preferences_page_test_factory;
+
+class CPrefsAdvanced : public CDialogImpl<CPrefsAdvanced>, public preferences_page_instance {
+public:
+	CPrefsAdvanced(preferences_page_callback::ptr callback) : m_callback(callback) {}
+
+	enum { IDD = IDD_PREFS_ADVANCED };
+
+	t_uint32 get_state();
+	void apply();
+	void reset();
+
+	BEGIN_MSG_MAP_EX(CPrefsAdvanced)
+		MSG_WM_INITDIALOG(OnInitDialog)
+		COMMAND_HANDLER_EX(IDC_CONCURRENCY, EN_CHANGE, OnEditChange)
+		COMMAND_HANDLER_EX(IDC_BATCH_SIZE, EN_CHANGE, OnEditChange)
+		COMMAND_HANDLER_EX(IDC_RATE_RPM, EN_CHANGE, OnEditChange)
+		COMMAND_HANDLER_EX(IDC_RATE_TPM, EN_CHANGE, OnEditChange)
+		COMMAND_HANDLER_EX(IDC_FAST_KEYS, BN_CLICKED, OnEditChange)
+		COMMAND_HANDLER_EX(IDC_INDEX_STORAGE, BN_CLICKED, OnEditChange)
+		COMMAND_HANDLER_EX(IDC_STREAM, BN_CLICKED, OnEditChange)
+		COMMAND_HANDLER_EX(IDC_LOCAL_ENGINE, BN_CLICKED, OnEditChange)
+		COMMAND_HANDLER_EX(IDC_AUTO_LATINIZE, BN_CLICKED, OnEditChange)
+		COMMAND_HANDLER_EX(IDC_AUTO_THREADS, EN_CHANGE, OnEditChange)
+		COMMAND_HANDLER_EX(IDC_AUTO_PAUSE, BN_CLICKED, OnEditChange)
+		COMMAND_HANDLER_EX(IDC_NEGATIVE_TTL, EN_CHANGE, OnEditChange)
+		COMMAND_HANDLER_EX(IDC_KEEP_ALIVE, BN_CLICKED, OnEditChange)
+		COMMAND_HANDLER_EX(IDC_HTTP2, BN_CLICKED, OnEditChange)
+	END_MSG_MAP()
+private:
+	BOOL OnInitDialog(CWindow, LPARAM);
+	void OnEditChange(UINT, int, CWindow);
+	bool HasChanged();
+	void OnChanged();
+	t_uint32 GetUInt(int id, t_uint32 lo, t_uint32 hi);
+
+	const preferences_page_callback::ptr m_callback;
+	fb2k::CDarkModeHooks m_dark;
+};
+
+BOOL CPrefsAdvanced::OnInitDialog(CWindow, LPARAM) {
+	m_dark.AddDialogWithControls(*this);
+
+	SetDlgItemInt(IDC_CONCURRENCY, cfg_concurrency.get(), FALSE);
+	SetDlgItemInt(IDC_BATCH_SIZE, cfg_batch_size.get(), FALSE);
+	SetDlgItemInt(IDC_RATE_RPM, cfg_rate_rpm.get(), FALSE);
+	SetDlgItemInt(IDC_RATE_TPM, cfg_rate_tpm.get(), FALSE);
+	CheckDlgButton(IDC_FAST_KEYS, cfg_fast_keys.get() ? BST_CHECKED : BST_UNCHECKED);
+	CheckDlgButton(IDC_INDEX_STORAGE, cfg_index_storage.get() ? BST_CHECKED : BST_UNCHECKED);
+	CheckDlgButton(IDC_STREAM, cfg_stream.get() ? BST_CHECKED : BST_UNCHECKED);
+	CheckDlgButton(IDC_LOCAL_ENGINE, cfg_local_engine.get() ? BST_CHECKED : BST_UNCHECKED);
+	CheckDlgButton(IDC_AUTO_LATINIZE, cfg_auto_latinize.get() ? BST_CHECKED : BST_UNCHECKED);
+	SetDlgItemInt(IDC_AUTO_THREADS, cfg_auto_threads.get(), FALSE);
+	CheckDlgButton(IDC_AUTO_PAUSE, cfg_auto_pause_playback.get() ? BST_CHECKED : BST_UNCHECKED);
+	SetDlgItemInt(IDC_NEGATIVE_TTL, cfg_negative_ttl.get(), FALSE);
+	CheckDlgButton(IDC_KEEP_ALIVE, cfg_keep_alive.get() ? BST_CHECKED : BST_UNCHECKED);
+	CheckDlgButton(IDC_HTTP2, cfg_http2.get() ? BST_CHECKED : BST_UNCHECKED);
+	return FALSE;
+}
+
+void CPrefsAdvanced::OnEditChange(UINT, int, CWindow) {
+	OnChanged();
+}
+
+// Reads a numeric edit box, clamped to the setting's valid range.
+t_uint32 CPrefsAdvanced::GetUInt(int id, t_uint32 lo, t_uint32 hi) {
+	const t_uint32 v = GetDlgItemInt(id, NULL, FALSE);
+	if (v < lo) return lo;
+	if (v > hi) return hi;
+	return v;
+}
+
+t_uint32 CPrefsAdvanced::get_state() {
+	t_uint32 state = preferences_state::resettable | preferences_state::dark_mode_supported;
+	if (HasChanged()) state |= preferences_state::changed;
+	return state;
+}
+
+void CPrefsAdvanced::reset() {
+	SetDlgItemInt(IDC_CONCURRENCY, default_concurrency(), FALSE);
+	SetDlgItemInt(IDC_BATCH_SIZE, default_batch_size(), FALSE);
+	SetDlgItemInt(IDC_RATE_RPM, default_rate_rpm(), FALSE);
+	SetDlgItemInt(IDC_RATE_TPM, default_rate_tpm(), FALSE);
+	CheckDlgButton(IDC_FAST_KEYS, default_fast_keys() ? BST_CHECKED : BST_UNCHECKED);
+	CheckDlgButton(IDC_INDEX_STORAGE, default_index_storage() ? BST_CHECKED : BST_UNCHECKED);
+	CheckDlgButton(IDC_STREAM, default_stream() ? BST_CHECKED : BST_UNCHECKED);
+	CheckDlgButton(IDC_LOCAL_ENGINE, default_local_engine() ? BST_CHECKED : BST_UNCHECKED);
+	CheckDlgButton(IDC_AUTO_LATINIZE, default_auto_latinize() ? BST_CHECKED : BST_UNCHECKED);
+	SetDlgItemInt(IDC_AUTO_THREADS, default_auto_threads(), FALSE);
+	CheckDlgButton(IDC_AUTO_PAUSE, default_auto_pause_playback() ? BST_CHECKED : BST_UNCHECKED);
+	SetDlgItemInt(IDC_NEGATIVE_TTL, default_negative_ttl(), FALSE);
+	CheckDlgButton(IDC_KEEP_ALIVE, default_keep_alive() ? BST_CHECKED : BST_UNCHECKED);
+	CheckDlgButton(IDC_HTTP2, default_http2() ? BST_CHECKED : BST_UNCHECKED);
+	OnChanged();
+}
+
+void CPrefsAdvanced::apply() {
+	const bool fastKeys = IsDlgButtonChecked(IDC_FAST_KEYS) == BST_CHECKED;
+	const bool fastKeysChanged = fastKeys != (cfg_fast_keys.get() != 0);
+	cfg_concurrency = GetUInt(IDC_CONCURRENCY, concurrency_min, concurrency_max);
+	cfg_batch_size = GetUInt(IDC_BATCH_SIZE, batch_size_min, batch_size_max);
+	cfg_rate_rpm = GetUInt(IDC_RATE_RPM, 0, rate_rpm_max);
+	cfg_rate_tpm = GetUInt(IDC_RATE_TPM, 0, rate_tpm_max);
+	cfg_fast_keys = fastKeys ? 1 : 0;
+	cfg_index_storage = IsDlgButtonChecked(IDC_INDEX_STORAGE) == BST_CHECKED ? 1 : 0;
+	cfg_stream = IsDlgButtonChecked(IDC_STREAM) == BST_CHECKED ? 1 : 0;
+	cfg_local_engine = IsDlgButtonChecked(IDC_LOCAL_ENGINE) == BST_CHECKED ? 1 : 0;
+	cfg_auto_latinize = IsDlgButtonChecked(IDC_AUTO_LATINIZE) == BST_CHECKED ? 1 : 0;
+	cfg_auto_threads = GetUInt(IDC_AUTO_THREADS, concurrency_min, concurrency_max);
+	cfg_auto_pause_playback = IsDlgButtonChecked(IDC_AUTO_PAUSE) == BST_CHECKED ? 1 : 0;
+	cfg_negative_ttl = GetUInt(IDC_NEGATIVE_TTL, 0, negative_ttl_max);
+	cfg_keep_alive = IsDlgButtonChecked(IDC_KEEP_ALIVE) == BST_CHECKED ? 1 : 0;
+	cfg_http2 = IsDlgButtonChecked(IDC_HTTP2) == BST_CHECKED ? 1 : 0;
+	// An empty cache switches key scheme right away.
+	if (fastKeysChanged) reload_cache();
+	// Show the clamped values actually stored.
+	SetDlgItemInt(IDC_CONCURRENCY, cfg_concurrency.get(), FALSE);
+	SetDlgItemInt(IDC_BATCH_SIZE, cfg_batch_size.get(), FALSE);
+	SetDlgItemInt(IDC_RATE_RPM, cfg_rate_rpm.get(), FALSE);
+	SetDlgItemInt(IDC_RATE_TPM, cfg_rate_tpm.get(), FALSE);
+	SetDlgItemInt(IDC_AUTO_THREADS, cfg_auto_threads.get(), FALSE);
+	SetDlgItemInt(IDC_NEGATIVE_TTL, cfg_negative_ttl.get(), FALSE);
+	OnChanged();
+}
+
+bool CPrefsAdvanced::HasChanged() {
+	if (GetDlgItemInt(IDC_CONCURRENCY, NULL, FALSE) != cfg_concurrency.get()) return true;
+	if (GetDlgItemInt(IDC_BATCH_SIZE, NULL, FALSE) != cfg_batch_size.get()) return true;
+	if (GetDlgItemInt(IDC_RATE_RPM, NULL, FALSE) != cfg_rate_rpm.get()) return true;
+	if (GetDlgItemInt(IDC_RATE_TPM, NULL, FALSE) != cfg_rate_tpm.get()) return true;
+	if ((IsDlgButtonChecked(IDC_FAST_KEYS) == BST_CHECKED) != (cfg_fast_keys.get() != 0)) return true;
+	if ((IsDlgButtonChecked(IDC_INDEX_STORAGE) == BST_CHECKED) != (cfg_index_storage.get() != 0)) return true;
+	if ((IsDlgButtonChecked(IDC_STREAM) == BST_CHECKED) != (cfg_stream.get() != 0)) return true;
+	if ((IsDlgButtonChecked(IDC_LOCAL_ENGINE) == BST_CHECKED) != (cfg_local_engine.get() != 0)) return true;
+	if ((IsDlgButtonChecked(IDC_AUTO_LATINIZE) == BST_CHECKED) != (cfg_auto_latinize.get() != 0)) return true;
+	if (GetDlgItemInt(IDC_AUTO_THREADS, NULL, FALSE) != cfg_auto_threads.get()) return true;
+	if ((IsDlgButtonChecked(IDC_AUTO_PAUSE) == BST_CHECKED) != (cfg_auto_pause_playback.get() != 0)) return true;
+	if (GetDlgItemInt(IDC_NEGATIVE_TTL, NULL, FALSE) != cfg_negative_ttl.get()) return true;
+	if ((IsDlgButtonChecked(IDC_KEEP_ALIVE) == BST_CHECKED) != (cfg_keep_alive.get() != 0)) return true;
+	if ((IsDlgButtonChecked(IDC_HTTP2) == BST_CHECKED) != (cfg_http2.get() != 0)) return true;
+	return false;
+}
+
+void CPrefsAdvanced::OnChanged() {
+	m_callback->on_state_changed();
+}
+
+class preferences_page_advanced : public preferences_page_impl<CPrefsAdvanced> {
+public:
+	const char* get_name() { return "Latinize Advanced"; }
+	GUID get_guid() {
+		return GUID{ 0x6c3f2a47, 0x95b1, 0x4e08, { 0xb3, 0x2d, 0x71, 0x0a, 0xe5, 0x4c, 0x9f, 0x16 } };
+	}
+	GUID get_parent_guid() { return guid_tools; }
+};
+
+static preferences_page_factory_t<preferences_page_advanced> g_preferences_page_advanced_factory;
 #endif // _WIN32
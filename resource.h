@@ -6,6 +6,8 @@
 #define IDD_PREFS_MAIN                 148
 #define IDD_PREFS_CACHE                149
 #define IDD_PREFS_TEST                 150
+#define IDD_PREFS_ADVANCED             151
+#define IDD_PREFS_STATS                152
 
 // Main preferences page controls
 #define IDC_API_URL                    1100
@@ -13,6 +15,7 @@
 #define IDC_MODEL                      1102
 #define IDC_PROMPT                     1103
 #define IDC_DB_PATH                    1104
+#define IDC_BATCH_PROMPT               1105
 
 // Cache management page controls
 #define IDC_CACHE_LIST                 1200
@@ -34,13 +37,35 @@
 #define IDC_TEST_OUTPUT                1303
 #define IDC_TEST_RAW                   1304
 
+// Advanced page controls (throughput tuning)
+#define IDC_CONCURRENCY                1400
+#define IDC_BATCH_SIZE                 1401
+#define IDC_RATE_RPM                   1402
+#define IDC_RATE_TPM                   1403
+#define IDC_FAST_KEYS                  1404
+#define IDC_INDEX_STORAGE              1405
+#define IDC_STREAM                     1406
+#define IDC_LOCAL_ENGINE               1407
+#define IDC_AUTO_LATINIZE              1408
+#define IDC_AUTO_THREADS               1409
+#define IDC_AUTO_PAUSE                 1410
+#define IDC_NEGATIVE_TTL               1411
+#define IDC_KEEP_ALIVE                 1412
+#define IDC_HTTP2                      1413
+
+// Stats page controls (run telemetry)
+#define IDC_STATS_LIST                 1500
+#define IDC_STATS_REFRESH              1501
+#define IDC_STATS_EXPORT               1502
+#define IDC_STATS_CLEAR                1503
+
 // Next default values for new objects
 // 
 #ifdef APSTUDIO_INVOKED
 #ifndef APSTUDIO_READONLY_SYMBOLS
-#define _APS_NEXT_RESOURCE_VALUE        151
+#define _APS_NEXT_RESOURCE_VALUE        153
 #define _APS_NEXT_COMMAND_VALUE         40001
-#define _APS_NEXT_CONTROL_VALUE         1312
+#define _APS_NEXT_CONTROL_VALUE         1504
 #define _APS_NEXT_SYMED_VALUE           101
 #endif
 #endif
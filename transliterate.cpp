@@ -0,0 +1,455 @@
+#include "stdafx.h"
+#include "transliterate.h"
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+	// Hepburn for U+3041..U+3096; katakana U+30A1..U+30F6 map onto the same
+	// slots (offset 0x60). Empty entries are handled in code (small tsu).
+	static const char* const kana_romaji[] = {
+		"a", "a", "i", "i", "u", "u", "e", "e", "o", "o",                         // 3041-304A
+		"ka", "ga", "ki", "gi", "ku", "gu", "ke", "ge", "ko", "go",               // 304B-3054
+		"sa", "za", "shi", "ji", "su", "zu", "se", "ze", "so", "zo",              // 3055-305E
+		"ta", "da", "chi", "ji", "", "tsu", "zu", "te", "de", "to", "do",         // 305F-3069
+		"na", "ni", "nu", "ne", "no",                                             // 306A-306E
+		"ha", "ba", "pa", "hi", "bi", "pi", "fu", "bu", "pu",                     // 306F-3077
+		"he", "be", "pe", "ho", "bo", "po",                                       // 3078-307D
+		"ma", "mi", "mu", "me", "mo",                                             // 307E-3082
+		"ya", "ya", "yu", "yu", "yo", "yo",                                       // 3083-3088
+		"ra", "ri", "ru", "re", "ro",                                             // 3089-308D
+		"wa", "wa", "i", "e", "o", "n", "vu", "ka", "ke",                         // 308E-3096
+	};
+	static_assert(sizeof(kana_romaji) / sizeof(kana_romaji[0]) == 0x3096 - 0x3041 + 1, "kana table size");
+
+	static bool is_small_kana(unsigned hira) {
+		switch (hira) {
+		case 0x3041: case 0x3043: case 0x3045: case 0x3047: case 0x3049:
+		case 0x3083: case 0x3085: case 0x3087: case 0x308E:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// Latin-1 letters U+00C0..U+00FF folded to ASCII; null for the two symbols.
+	static const char* const latin1_fold[] = {
+		"A", "A", "A", "A", "A", "A", "AE", "C", "E", "E", "E", "E", "I", "I", "I", "I",
+		"D", "N", "O", "O", "O", "O", "O", nullptr, "O", "U", "U", "U", "U", "Y", "TH", "ss",
+		"a", "a", "a", "a", "a", "a", "ae", "c", "e", "e", "e", "e", "i", "i", "i", "i",
+		"d", "n", "o", "o", "o", "o", "o", nullptr, "o", "u", "u", "u", "u", "y", "th", "y",
+	};
+
+	enum char_class { cc_latin, cc_separator, cc_kana, cc_han, cc_other };
+
+	static bool is_han(unsigned c) {
+		return (c >= 0x4E00 && c <= 0x9FFF) || (c >= 0x3400 && c <= 0x4DBF)
+			|| (c >= 0xF900 && c <= 0xFAFF) || (c >= 0x20000 && c <= 0x3134F);
+	}
+
+	static bool is_kana(unsigned c) {
+		return (c >= 0x3041 && c <= 0x3096) || (c >= 0x309D && c <= 0x309E)
+			|| (c >= 0x30A1 && c <= 0x30FA) || (c >= 0x30FC && c <= 0x30FE);
+	}
+
+	static char_class classify(unsigned c) {
+		if (c < 0x80) {
+			const bool alnum = (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+			return alnum ? cc_latin : cc_separator;
+		}
+		if (c >= 0xC0 && c <= 0xFF) return latin1_fold[c - 0xC0] ? cc_latin : cc_separator;
+		if (c >= 0xFF10 && c <= 0xFF19) return cc_latin;   // fullwidth digits
+		if ((c >= 0xFF21 && c <= 0xFF3A) || (c >= 0xFF41 && c <= 0xFF5A)) return cc_latin;
+		if (is_kana(c)) return cc_kana;
+		if (is_han(c) || c == 0x3007) return cc_han;   // 〇 reads "ling"
+		if (c >= 0x80 && c <= 0xBF) return cc_separator;     // Latin-1 symbols, NBSP
+		if (c >= 0x2000 && c <= 0x206F) return cc_separator; // general punctuation
+		if (c >= 0x3000 && c <= 0x303F && c != 0x3005) return cc_separator; // CJK punctuation (not 々)
+		if (c == 0x30FB) return cc_separator;                // katakana middle dot
+		if ((c >= 0xFF01 && c <= 0xFF0F) || (c >= 0xFF1A && c <= 0xFF20)
+			|| (c >= 0xFF3B && c <= 0xFF40) || (c >= 0xFF5B && c <= 0xFF65)) return cc_separator;
+		return cc_other;
+	}
+
+	// Coarse class of each 256-code-point block of the BMP. Blocks that mix
+	// classes (ASCII/Latin-1, punctuation, kana, fullwidth forms) are marked
+	// blk_detail and resolved per character by classify().
+	enum block_class : t_uint8 { blk_other, blk_detail, blk_han };
+
+	struct block_table {
+		block_class blocks[256];
+
+		block_table() {
+			for (unsigned b = 0; b < 256; ++b) {
+				const unsigned first = b << 8, last = first + 0xFF;
+				if (b == 0x00 || b == 0x20 || b == 0x30 || b == 0x4D || b == 0xFF) blocks[b] = blk_detail;
+				else if (is_han(first) && is_han(last)) blocks[b] = blk_han;
+				else blocks[b] = blk_other;
+			}
+		}
+	};
+
+	static const block_table g_blocks;
+
+	static char_class classify_fast(unsigned c) {
+		if (c < 0x10000) {
+			const block_class b = g_blocks.blocks[c >> 8];
+			if (b == blk_han) return cc_han;
+			if (b == blk_other) return cc_other;
+			return classify(c);
+		}
+		return is_han(c) ? cc_han : cc_other;
+	}
+
+	// True when none of the `length` bytes has the high bit set; checks eight
+	// bytes per step (the usual tag value is pure ASCII).
+	static bool is_ascii(const char* p, size_t length) {
+		static constexpr t_uint64 high = 0x8080808080808080ull;
+		size_t i = 0;
+		for (; i + 8 <= length; i += 8) {
+			t_uint64 w;
+			memcpy(&w, p + i, 8);
+			if (w & high) return false;
+		}
+		for (; i < length; ++i) {
+			if ((unsigned char)p[i] & 0x80) return false;
+		}
+		return true;
+	}
+
+	static void append_latin(pfc::string8& out, unsigned c) {
+		if (c < 0x80) out.add_char((char)c);
+		else if (c >= 0xC0 && c <= 0xFF) out << latin1_fold[c - 0xC0];
+		else out.add_char((char)(c - 0xFEE0));   // fullwidth ASCII
+	}
+
+	static bool is_vowel(char c) {
+		return c == 'a' || c == 'i' || c == 'u' || c == 'e' || c == 'o';
+	}
+
+	// Hepburn writer for one run of kana. Small kana combine with the
+	// syllable before them, small tsu doubles the next consonant and the
+	// long-vowel mark is dropped, as in simplified Hepburn.
+	class kana_writer {
+	public:
+		explicit kana_writer(pfc::string8& out) : m_out(out) {}
+
+		// Starts a new run; nothing carries over from the previous one.
+		void reset() {
+			m_last = npos;
+			m_sokuon = false;
+		}
+
+		// False for kana whose reading depends on context (ゞ, ヶ, ...).
+		bool put(unsigned c) {
+			if (c == 0x30FC) return true;   // ー
+			if (c == 0x309D || c == 0x30FD) {   // ゝ ヽ repeat the previous syllable
+				if (m_last == npos) return false;
+				const pfc::string8 prev(m_out.c_str() + m_last);
+				m_last = m_out.length();
+				m_out << prev;
+				return true;
+			}
+			if (c == 0x309E || c == 0x30FE) return false;   // voiced repeat marks
+			if (c >= 0x30F7 && c <= 0x30FA) {
+				static const char* const v[] = { "va", "vi", "ve", "vo" };
+				syllable(v[c - 0x30F7]);
+				return true;
+			}
+			const unsigned hira = c >= 0x30A1 ? c - 0x60 : c;
+			if (hira == 0x3095 || hira == 0x3096) return false;   // ヵ ヶ: ka/ga/ko in names
+			if (hira == 0x3063) {   // っ
+				m_sokuon = true;
+				return true;
+			}
+			const char* r = kana_romaji[hira - 0x3041];
+			if (is_small_kana(hira) && combine(r)) return true;
+			syllable(r);
+			return true;
+		}
+
+	private:
+		enum : size_t { npos = ~(size_t)0 };
+
+		void syllable(const char* r) {
+			if (m_sokuon) {
+				if (r[0] == 'c') m_out.add_char('t');   // っち -> tchi
+				else if (!is_vowel(r[0]) && r[0] != 'n') m_out.add_char(r[0]);
+				m_sokuon = false;
+			}
+			m_last = m_out.length();
+			m_out << r;
+		}
+
+		// Merges a small kana into the previous syllable: きゃ -> kya,
+		// しゃ -> sha, ファ -> fa, ティ -> ti, ウィ -> wi.
+		bool combine(const char* r) {
+			if (m_last == npos || m_sokuon) return false;
+			const size_t len = m_out.length() - m_last;
+			const char* prev = m_out.c_str() + m_last;
+			if (len == 0 || !is_vowel(prev[len - 1])) return false;
+			if (r[0] == 'y') {
+				// Only i-row syllables take small ya/yu/yo.
+				if (len < 2 || prev[len - 1] != 'i') return false;
+				const bool palatal = !strcmp(prev, "shi") || !strcmp(prev, "chi") || !strcmp(prev, "ji");
+				m_out.truncate(m_out.length() - 1);
+				m_out << (palatal ? r + 1 : r);
+				return true;
+			}
+			if (r[0] == 'w') return false;
+			if (len == 1) {
+				if (prev[0] != 'u') return false;
+				m_out.truncate(m_last);
+				m_out << "w" << r;   // ウィ ウェ ウォ
+				return true;
+			}
+			m_out.truncate(m_out.length() - 1);
+			m_out << r;
+			return true;
+		}
+
+		pfc::string8& m_out;
+		size_t m_last = npos;   // start of the previous syllable in m_out
+		bool m_sokuon = false;
+	};
+
+	// Code point -> toneless pinyin syllable, sorted by code point. Syllables
+	// are interned (a few hundred distinct ones), so an entry is 8 bytes.
+	class pinyin_table {
+	public:
+		void load(const char* path) {
+			pfc::string8 text;
+			try {
+				abort_callback_dummy abort;
+				file::ptr f;
+				filesystem::g_open_read(f, path, abort);
+				f->read_string_raw(text, abort);
+			} catch (exception_io_not_found const&) {
+				return;
+			} catch (exception_io const&) {
+				FB2K_console_formatter() << "[latinize] Failed to read pinyin table: " << path;
+				return;
+			}
+
+			std::unordered_map<std::string, t_uint16> interned;
+			const char* p = text.c_str();
+			while (*p) {
+				const char* eol = p;
+				while (*eol && *eol != '\n') ++eol;
+				parse_line(p, eol, interned);
+				p = *eol ? eol + 1 : eol;
+			}
+
+			std::sort(m_entries.begin(), m_entries.end(), [](const entry& a, const entry& b) { return a.cp < b.cp; });
+			// Merge repeated code points; differing readings make a character polyphonic.
+			size_t w = 0;
+			for (size_t r = 0; r < m_entries.size(); ++r) {
+				if (w > 0 && m_entries[w - 1].cp == m_entries[r].cp) {
+					if (m_entries[w - 1].syllable != m_entries[r].syllable) m_entries[w - 1].polyphonic = 1;
+					m_entries[w - 1].polyphonic |= m_entries[r].polyphonic;
+					continue;
+				}
+				m_entries[w++] = m_entries[r];
+			}
+			m_entries.resize(w);
+			m_entries.shrink_to_fit();
+			FB2K_console_formatter() << "[latinize] Loaded pinyin table: " << (t_size)m_entries.size()
+				<< " character(s), " << (t_size)m_syllables.size() << " syllable(s) from " << path;
+		}
+
+		// Null when the character is unknown or has several toneless readings.
+		const char* lookup(unsigned cp) const {
+			auto it = std::lower_bound(m_entries.begin(), m_entries.end(), cp, [](const entry& e, unsigned v) { return e.cp < v; });
+			if (it == m_entries.end() || it->cp != cp || it->polyphonic) return nullptr;
+			return m_syllables[it->syllable].c_str();
+		}
+
+	private:
+		struct entry {
+			t_uint32 cp;
+			t_uint16 syllable;
+			t_uint16 polyphonic;
+		};
+
+		static bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+		// Tone-marked vowels -> plain letters; ü becomes "v" as in common pinyin input.
+		static const char* untone(unsigned c) {
+			switch (c) {
+			case 0x0101: case 0x00E1: case 0x01CE: case 0x00E0: return "a";
+			case 0x0113: case 0x00E9: case 0x011B: case 0x00E8: case 0x00EA: case 0x1EBF: case 0x1EC1: return "e";
+			case 0x012B: case 0x00ED: case 0x01D0: case 0x00EC: return "i";
+			case 0x014D: case 0x00F3: case 0x01D2: case 0x00F2: return "o";
+			case 0x016B: case 0x00FA: case 0x01D4: case 0x00F9: return "u";
+			case 0x01D6: case 0x01D8: case 0x01DA: case 0x01DC: case 0x00FC: return "v";
+			case 0x0144: case 0x0148: case 0x01F9: return "n";
+			case 0x1E3F: return "m";
+			default: return nullptr;
+			}
+		}
+
+		// Reads one reading token; false if it holds anything but pinyin.
+		static bool read_syllable(const char*& p, const char* end, std::string& out) {
+			out.clear();
+			while (p < end && !is_blank(*p) && *p != ',' && *p != '#') {
+				unsigned c = 0;
+				const t_size n = pfc::utf8_decode_char(p, c, end - p);
+				if (n == 0) return false;
+				p += n;
+				if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+				if (c >= 'a' && c <= 'z') out.push_back((char)c);
+				else if (c >= '0' && c <= '5') continue;   // numeric tone
+				else if (const char* plain = untone(c)) out += plain;
+				else return false;
+			}
+			return !out.empty();
+		}
+
+		void parse_line(const char* p, const char* end, std::unordered_map<std::string, t_uint16>& interned) {
+			while (p < end && is_blank(*p)) ++p;
+			if (p >= end || *p == '#') return;
+
+			unsigned cp = 0;
+			if ((p[0] == 'U' || p[0] == 'u') && p + 1 < end && p[1] == '+') {
+				p += 2;
+				const char* hex = p;
+				for (; p < end && isxdigit((unsigned char)*p); ++p) {
+					const char h = (char)tolower((unsigned char)*p);
+					cp = cp * 16 + (unsigned)(h <= '9' ? h - '0' : h - 'a' + 10);
+				}
+				if (p == hex || cp > 0x10FFFF) return;
+			} else {
+				const t_size n = pfc::utf8_decode_char(p, cp, end - p);
+				if (n == 0) return;
+				p += n;
+			}
+			if (classify(cp) != cc_han) return;
+
+			while (p < end && (is_blank(*p) || *p == ':')) ++p;
+			if (p < end && *p == 'k') {
+				// Unihan_Readings.txt: only the kMandarin field carries plain readings.
+				const char* field = p;
+				while (p < end && !is_blank(*p)) ++p;
+				if ((size_t)(p - field) != 9 || memcmp(field, "kMandarin", 9) != 0) return;
+			}
+
+			std::string syllable;
+			bool first = true;
+			while (p < end && *p != '#') {
+				while (p < end && (is_blank(*p) || *p == ',')) ++p;
+				if (p >= end || *p == '#') break;
+				if (!read_syllable(p, end, syllable)) {
+					while (p < end && !is_blank(*p) && *p != ',') ++p;
+					continue;
+				}
+				auto it = interned.find(syllable);
+				if (it == interned.end()) {
+					if (m_syllables.size() >= 0xFFFF) return;
+					it = interned.emplace(syllable, (t_uint16)m_syllables.size()).first;
+					m_syllables.push_back(pfc::string8(syllable.c_str()));
+				}
+				if (first) {
+					entry e;
+					e.cp = cp;
+					e.syllable = it->second;
+					e.polyphonic = 0;
+					m_entries.push_back(e);
+					first = false;
+				} else if (m_entries.back().syllable != it->second) {
+					m_entries.back().polyphonic = 1;
+				}
+			}
+		}
+
+		std::vector<entry> m_entries;
+		std::vector<pfc::string8> m_syllables;
+	};
+
+	static const pinyin_table& get_pinyin_table() {
+		static pinyin_table table;
+		static std::once_flag once;
+		std::call_once(once, [] { table.load(foo_latinize::get_pinyin_table_path()); });
+		return table;
+	}
+}
+
+namespace foo_latinize {
+	pfc::string8 get_pinyin_table_path() {
+		return core_api::pathInProfile("foo_latin_pinyin.txt");
+	}
+
+	text_script classify_script(const char* in) {
+		if (!in) return script_ascii;
+		const size_t length = strlen(in);
+		if (is_ascii(in, length)) return script_ascii;
+
+		bool hasLatin = false, hasKana = false, hasHan = false;
+		for (const char* p = in; *p;) {
+			unsigned c = 0;
+			const t_size n = pfc::utf8_decode_char(p, c);
+			if (n == 0) return script_other;
+			p += n;
+			switch (c < 0x80 ? cc_separator : classify_fast(c)) {
+			case cc_latin: hasLatin = true; break;
+			case cc_kana: hasKana = true; break;
+			case cc_han: hasHan = true; break;
+			case cc_other: return script_other;
+			default: break;
+			}
+		}
+		// Kana makes the text Japanese, and without a dictionary kanji in
+		// Japanese text cannot be read.
+		if (hasKana && hasHan) return script_mixed;
+		if (hasHan) return script_han;
+		if (hasKana) return script_kana;
+		return hasLatin ? script_latin : script_ascii;
+	}
+
+	bool transliterate_local(const char* in, pfc::string8& out, text_script* outScript) {
+		out.reset();
+		const text_script script = classify_script(in);
+		if (outScript) *outScript = script;
+		if (script == script_ascii) {
+			if (in) out = in;
+			return true;
+		}
+		if (script == script_mixed || script == script_other) return false;
+		const pinyin_table* pinyin = script == script_han ? &get_pinyin_table() : nullptr;
+
+		kana_writer kana(out);
+		char_class prev = cc_separator;
+		for (const char* p = in; *p;) {
+			unsigned c = 0;
+			p += pfc::utf8_decode_char(p, c);
+			const char_class cls = classify_fast(c);
+			// Keep words from different scripts apart: "ラブsong" -> "rabu song".
+			if (cls != cc_separator && prev != cc_separator && (cls == cc_latin) != (prev == cc_latin)) out.add_char(' ');
+			switch (cls) {
+			case cc_latin:
+				append_latin(out, c);
+				break;
+			case cc_separator:
+				out.add_char(' ');
+				break;
+			case cc_kana:
+				if (prev != cc_kana) kana.reset();
+				if (!kana.put(c)) return false;
+				break;
+			case cc_han: {
+				const char* syllable = pinyin->lookup(c);
+				if (!syllable) return false;
+				if (prev == cc_han) out.add_char(' ');
+				out << syllable;
+				break;
+			}
+			default:
+				return false;
+			}
+			prev = cls;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "stdafx.h"
+
+namespace foo_latinize {
+	// What a tag value is written in, as far as latinization is concerned.
+	enum text_script {
+		script_ascii,   // nothing to transliterate
+		script_latin,   // Latin-1 letters (accents are folded)
+		script_kana,    // kana, possibly with Latin
+		script_han,     // hanzi without kana: read as Chinese
+		script_mixed,   // kana and kanji: Japanese that needs a dictionary
+		script_other,   // any other script, or invalid UTF-8
+	};
+
+	// Fast classifier: whole-word ASCII check first, then a per-block table.
+	text_script classify_script(const char* in);
+
+	// Local, deterministic latinization tried before any API request.
+	// Handles plain Latin (Latin-1 letters are folded to ASCII), fullwidth
+	// forms, kana (Hepburn) and hanzi found in the pinyin table. Returns false
+	// when the text needs the model: kanji mixed with kana, hanzi that are
+	// missing from the table or have several readings, or any other script.
+	// The output is raw romaji/pinyin; callers still run it through the usual
+	// sanitizer. `outScript`, if set, receives classify_script(in). Thread-safe.
+	bool transliterate_local(const char* in, pfc::string8& out, text_script* outScript = nullptr);
+
+	// Optional pinyin table in the profile directory, read on first use.
+	// Lines look like "U+4E2D: zhōng,zhòng" (pinyin-data), "U+4E2D<tab>kMandarin<tab>zhōng"
+	// (Unihan_Readings.txt) or "中 zhong1"; tone marks and digits are dropped.
+	pfc::string8 get_pinyin_table_path();
+}
@@ -0,0 +1,309 @@
+#include "stdafx.h"
+#include "transport.h"
+#include "latinize.h"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+
+#ifdef _WIN32
+#include <winhttp.h>
+
+// Newer SDK headers have these; HTTP/2 needs Windows 10 1607 or later and
+// is silently unavailable elsewhere.
+#ifndef WINHTTP_OPTION_ENABLE_HTTP_PROTOCOL
+#define WINHTTP_OPTION_ENABLE_HTTP_PROTOCOL 133
+#endif
+#ifndef WINHTTP_PROTOCOL_FLAG_HTTP2
+#define WINHTTP_PROTOCOL_FLAG_HTTP2 0x1
+#endif
+#ifndef WINHTTP_ACCESS_TYPE_AUTOMATIC_PROXY
+#define WINHTTP_ACCESS_TYPE_AUTOMATIC_PROXY 4
+#endif
+#endif
+
+namespace {
+	using foo_latinize::http_response;
+	using foo_latinize::http_transport;
+
+	static int parse_status_code(const char* statusLine) {
+		if (!statusLine) return 0;
+		// Expected: "HTTP/1.1 200 OK"
+		const char* p = strchr(statusLine, ' ');
+		if (!p) return 0;
+		++p;
+		if (p[0] < '0' || p[0] > '9') return 0;
+		int code = 0;
+		for (int i = 0; i < 3 && p[i] >= '0' && p[i] <= '9'; ++i) {
+			code = code * 10 + (p[i] - '0');
+		}
+		return code;
+	}
+
+	// foobar2000 http_client: honours the player's proxy settings, but every
+	// request pays for a new TCP and TLS handshake.
+	class fb2k_response : public http_response {
+	public:
+		explicit fb2k_response(file::ptr body) : m_body(body) {}
+
+		size_t read(void* buffer, size_t size, abort_callback& abort) override {
+			return m_body->read(buffer, size, abort);
+		}
+
+	private:
+		file::ptr m_body;
+	};
+
+	class fb2k_transport : public http_transport {
+	public:
+		std::unique_ptr<http_response> post_json(const char* url, const char* authorization,
+			const pfc::string8& body, abort_callback& abort) override {
+			http_request::ptr baseReq = static_api_ptr_t<http_client>()->create_request("POST");
+			http_request_post_v2::ptr req;
+			req ^= baseReq;
+			req->add_header("Content-Type", "application/json");
+			if (*authorization) req->add_header("Authorization", authorization);
+			req->set_post_data(body.get_ptr(), body.length(), "application/json");
+
+			file::ptr responseFile = req->run_ex(url, abort);
+			std::unique_ptr<http_response> out(new fb2k_response(responseFile));
+			// Headers are in before the body, so callers can look at them first.
+			http_reply::ptr reply;
+			reply ^= responseFile;
+			if (reply.is_valid()) {
+				reply->get_status(out->statusLine);
+				reply->get_http_header("content-type", out->contentType);
+				reply->get_http_header("retry-after", out->retryAfter);
+			}
+			out->status = parse_status_code(out->statusLine.c_str());
+			return out;
+		}
+
+		const char* name() const override { return "http_client"; }
+	};
+
+#ifdef _WIN32
+	// The request could not be sent (no session, unsupported URL, no
+	// connection); nothing reached the server, so another transport may try.
+	class exception_transport_unavailable : public exception_io {
+	public:
+		exception_transport_unavailable() : exception_io("transport unavailable") {}
+	};
+
+	// Closes the request handle when the abort event fires, which makes a
+	// blocking WinHTTP call on another thread return with an error.
+	class winhttp_abort_watch {
+	public:
+		winhttp_abort_watch(abort_callback& abort, HINTERNET request) : m_request(request) {
+			if (!RegisterWaitForSingleObject(&m_wait, abort.get_abort_event(), on_abort, this, INFINITE, WT_EXECUTEONLYONCE)) {
+				m_wait = NULL;
+			}
+		}
+		winhttp_abort_watch(const winhttp_abort_watch&) = delete;
+		winhttp_abort_watch& operator=(const winhttp_abort_watch&) = delete;
+
+		~winhttp_abort_watch() {
+			// Waits for a running callback, so m_fired is final afterwards.
+			if (m_wait != NULL) UnregisterWaitEx(m_wait, INVALID_HANDLE_VALUE);
+			if (!m_fired) WinHttpCloseHandle(m_request);
+		}
+
+	private:
+		static VOID CALLBACK on_abort(PVOID context, BOOLEAN) {
+			auto* self = static_cast<winhttp_abort_watch*>(context);
+			self->m_fired = true;
+			WinHttpCloseHandle(self->m_request);
+		}
+
+		HINTERNET m_request;
+		HANDLE m_wait = NULL;
+		std::atomic<bool> m_fired{ false };
+	};
+
+	class winhttp_response : public http_response {
+	public:
+		winhttp_response(abort_callback& abort, HINTERNET request) : m_request(request), m_watch(abort, request) {}
+
+		size_t read(void* buffer, size_t size, abort_callback& abort) override {
+			abort.check();
+			if (m_done) return 0;
+			DWORD got = 0;
+			if (!WinHttpReadData(m_request, buffer, (DWORD)pfc::min_t<size_t>(size, 1 << 20), &got)) {
+				abort.check();
+				throw exception_io("WinHTTP read failed");
+			}
+			if (got == 0) m_done = true;
+			return got;
+		}
+
+	private:
+		HINTERNET m_request;
+		winhttp_abort_watch m_watch;   // owns m_request
+		bool m_done = false;
+	};
+
+	// WinHTTP with one long-lived session per protocol setting. The session
+	// keeps idle connections open (HTTP/1.1 keep-alive) and reuses them for
+	// later requests to the same host, so only the first request of a run
+	// pays for the handshakes; with HTTP/2 concurrent workers share one
+	// connection. Uses the system (WinHTTP/IE) proxy configuration.
+	class winhttp_transport : public http_transport {
+	public:
+		~winhttp_transport() { close(); }
+
+		std::unique_ptr<http_response> post_json(const char* url, const char* authorization,
+			const pfc::string8& body, abort_callback& abort) override {
+			abort.check();
+			pfc::stringcvt::string_wide_from_utf8 wideUrl(url);
+			URL_COMPONENTS parts = {};
+			parts.dwStructSize = sizeof(parts);
+			parts.dwHostNameLength = (DWORD)-1;
+			parts.dwUrlPathLength = (DWORD)-1;
+			parts.dwExtraInfoLength = (DWORD)-1;
+			if (!WinHttpCrackUrl(wideUrl, 0, 0, &parts)) throw exception_transport_unavailable();
+			if (parts.nScheme != INTERNET_SCHEME_HTTP && parts.nScheme != INTERNET_SCHEME_HTTPS) throw exception_transport_unavailable();
+			const std::wstring host(parts.lpszHostName, parts.dwHostNameLength);
+			std::wstring path(parts.lpszUrlPath, parts.dwUrlPathLength);
+			if (parts.lpszExtraInfo != NULL) path.append(parts.lpszExtraInfo, parts.dwExtraInfoLength);
+			if (path.empty()) path = L"/";
+
+			HINTERNET connection = get_connection(host, parts.nPort);
+			HINTERNET request = WinHttpOpenRequest(connection, L"POST", path.c_str(), NULL, WINHTTP_NO_REFERER,
+				WINHTTP_DEFAULT_ACCEPT_TYPES, parts.nScheme == INTERNET_SCHEME_HTTPS ? WINHTTP_FLAG_SECURE : 0);
+			if (request == NULL) throw exception_transport_unavailable();
+			std::unique_ptr<winhttp_response> out(new winhttp_response(abort, request));
+
+			pfc::string8 headers = "Content-Type: application/json\r\n";
+			if (*authorization) headers << "Authorization: " << authorization << "\r\n";
+			pfc::stringcvt::string_wide_from_utf8 wideHeaders(headers);
+			if (!WinHttpSendRequest(request, wideHeaders, (DWORD)-1, (LPVOID)body.get_ptr(), (DWORD)body.length(), (DWORD)body.length(), 0)) {
+				abort.check();
+				throw exception_transport_unavailable();
+			}
+			// From here on the server may have acted on the request: errors are
+			// reported, never retried through another transport.
+			if (!WinHttpReceiveResponse(request, NULL)) {
+				abort.check();
+				throw exception_io("WinHTTP: no response");
+			}
+
+			DWORD status = 0;
+			DWORD size = sizeof(status);
+			WinHttpQueryHeaders(request, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER, WINHTTP_HEADER_NAME_BY_INDEX, &status, &size, WINHTTP_NO_HEADER_INDEX);
+			out->status = (int)status;
+			pfc::string8 version, text;
+			query_header(request, WINHTTP_QUERY_VERSION, version);
+			query_header(request, WINHTTP_QUERY_STATUS_TEXT, text);
+			out->statusLine << (version.length() > 0 ? version.c_str() : "HTTP/1.1") << " " << (unsigned)status;
+			if (text.length() > 0) out->statusLine << " " << text;
+			query_header(request, WINHTTP_QUERY_CONTENT_TYPE, out->contentType);
+			query_header(request, WINHTTP_QUERY_RETRY_AFTER, out->retryAfter);
+			return std::unique_ptr<http_response>(out.release());
+		}
+
+		const char* name() const override { return "winhttp"; }
+
+		void close() {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (auto& kv : m_connections) WinHttpCloseHandle(kv.second);
+			m_connections.clear();
+			for (auto& session : m_sessions) {
+				if (session != NULL) WinHttpCloseHandle(session);
+				session = NULL;
+			}
+		}
+
+	private:
+		static void query_header(HINTERNET request, DWORD info, pfc::string8& out) {
+			out.reset();
+			wchar_t buffer[256];
+			DWORD size = sizeof(buffer);
+			if (WinHttpQueryHeaders(request, info, WINHTTP_HEADER_NAME_BY_INDEX, buffer, &size, WINHTTP_NO_HEADER_INDEX)) {
+				out = pfc::stringcvt::string_utf8_from_wide(buffer, size / sizeof(wchar_t));
+			}
+		}
+
+		// Connection handles are cheap targets (host, port) within a session;
+		// the sockets behind them are pooled by the session itself.
+		HINTERNET get_connection(const std::wstring& host, INTERNET_PORT port) {
+			const bool http2 = foo_latinize::cfg_http2.get() != 0;
+			std::lock_guard<std::mutex> lock(m_mutex);
+			HINTERNET& session = m_sessions[http2 ? 1 : 0];
+			if (session == NULL) {
+				session = WinHttpOpen(L"foo_sample latinize", WINHTTP_ACCESS_TYPE_AUTOMATIC_PROXY, WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
+				// Automatic proxy needs Windows 8.1.
+				if (session == NULL) session = WinHttpOpen(L"foo_sample latinize", WINHTTP_ACCESS_TYPE_DEFAULT_PROXY, WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
+				if (session == NULL) throw exception_transport_unavailable();
+				// Batch answers can take minutes to start; streams pause between records.
+				WinHttpSetTimeouts(session, 0, 30000, 60000, 300000);
+				if (http2) {
+					DWORD protocols = WINHTTP_PROTOCOL_FLAG_HTTP2;
+					WinHttpSetOption(session, WINHTTP_OPTION_ENABLE_HTTP_PROTOCOL, &protocols, sizeof(protocols));
+				}
+			}
+
+			std::wstring key = host;
+			key += L":";
+			key += std::to_wstring(port);
+			if (http2) key += L"/h2";
+			auto it = m_connections.find(key);
+			if (it != m_connections.end()) return it->second;
+			HINTERNET connection = WinHttpConnect(session, host.c_str(), port, 0);
+			if (connection == NULL) throw exception_transport_unavailable();
+			m_connections.emplace(key, connection);
+			return connection;
+		}
+
+		std::mutex m_mutex;
+		HINTERNET m_sessions[2] = { NULL, NULL };   // HTTP/1.1 only, HTTP/2 allowed
+		std::map<std::wstring, HINTERNET> m_connections;
+	};
+
+	// Persistent connections first; http_client when they cannot be used.
+	class pooled_transport : public http_transport {
+	public:
+		std::unique_ptr<http_response> post_json(const char* url, const char* authorization,
+			const pfc::string8& body, abort_callback& abort) override {
+			try {
+				return m_winhttp.post_json(url, authorization, body, abort);
+			} catch (exception_transport_unavailable const&) {
+				if (!m_warned.exchange(true)) {
+					FB2K_console_formatter() << "[latinize] Persistent connections unavailable for " << url << "; using http_client.";
+				}
+			}
+			return m_fallback.post_json(url, authorization, body, abort);
+		}
+
+		const char* name() const override { return m_winhttp.name(); }
+
+		void close() { m_winhttp.close(); }
+
+	private:
+		winhttp_transport m_winhttp;
+		fb2k_transport m_fallback;
+		std::atomic<bool> m_warned{ false };
+	};
+
+	static pooled_transport g_pooled;
+#endif
+
+	static fb2k_transport g_fb2k;
+}
+
+namespace foo_latinize {
+	http_transport& get_transport(const char* url) {
+		// Keeps simulated answers out of the real cache.
+		if (!strncmp(url, "mock://", 7)) throw exception_io("mock:// URLs are only served to the offline benchmark");
+#ifdef _WIN32
+		if (cfg_keep_alive.get()) return g_pooled;
+#endif
+		return g_fb2k;
+	}
+
+	void shutdown_transport() {
+#ifdef _WIN32
+		g_pooled.close();
+#endif
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include <memory>
+
+namespace foo_latinize {
+	// Reply to a transport request: status and the few headers latinize looks
+	// at are available up front, the body is read as it arrives.
+	class http_response {
+	public:
+		virtual ~http_response() {}
+
+		int status = 0;                // 0 when the status line could not be parsed
+		pfc::string8 statusLine;       // e.g. "HTTP/1.1 200 OK"
+		pfc::string8 contentType;
+		pfc::string8 retryAfter;
+
+		// Returns 0 at the end of the body. Throws exception_io / exception_aborted.
+		virtual size_t read(void* buffer, size_t size, abort_callback& abort) = 0;
+	};
+
+	// How latinize reaches the API. Implementations are thread-safe; every
+	// worker posts through the same instance.
+	class http_transport {
+	public:
+		virtual ~http_transport() {}
+
+		// POSTs a JSON body; `authorization` may be empty. Throws exception_io
+		// on network errors and exception_aborted when `abort` fires.
+		virtual std::unique_ptr<http_response> post_json(const char* url, const char* authorization,
+			const pfc::string8& body, abort_callback& abort) = 0;
+
+		// Short name for logs ("http_client", "winhttp").
+		virtual const char* name() const = 0;
+	};
+
+	// Transport for `url`, picked by the settings: persistent connections
+	// (keep-alive, optionally HTTP/2) where the platform provides them,
+	// otherwise the foobar2000 http_client, which opens a new connection per
+	// request. Throws exception_io for mock:// URLs, which only the offline
+	// benchmark may use.
+	http_transport& get_transport(const char* url);
+
+#ifdef LATINIZE_BENCH
+	// Offline stand-in for a chat-completions endpoint (mock_transport.cpp,
+	// Bench configuration only). Answers the prompts latinize builds with
+	// plausible records after a simulated delay; the query string sets its
+	// behaviour, e.g.
+	// "mock://api?latency=150&jitter=50&errors=1&throttle=2&retry_after=1&drop=5"
+	// (milliseconds, percentages of requests or dropped batch records, seconds).
+	bool is_mock_url(const char* url);
+	http_transport& get_mock_transport();
+#endif
+
+	// Closes pooled connections; called on shutdown.
+	void shutdown_transport();
+}